@@ -0,0 +1,1531 @@
+#include "tachyon.h"
+
+static thread_local TachyonMutator* tachyon_current_mutator = nullptr;
+static thread_local TachyonWorker* tachyon_current_worker = nullptr;
+TachyonHeap tachyon_heap;
+std::atomic<std::size_t> tachyon_epoch(0);
+std::atomic<bool> tachyon_threaded(false);
+
+TachyonVal TachyonVal::make_object(const std::map<std::string, TachyonVal>& map) {
+    return TachyonVal::make_ptr(tachyon_heap.make<TachyonObject>(map));
+}
+
+TachyonVal TachyonVal::make_str(const std::string& s) {
+    TachyonString* o = tachyon_heap.make<TachyonString>(s);
+    o->bytes += s.size();
+    return TachyonVal::make_ptr(o);
+}
+
+TachyonVal TachyonVal::make_thread(const std::shared_ptr<TachyonTask>& task, const TachyonVal& proto) {
+    return TachyonVal::make_ptr(tachyon_heap.make<TachyonThread>(task, proto));
+}
+
+TachyonVal TachyonVal::make_vec(const TachyonVals& v) {
+    return TachyonVal::make_ptr(tachyon_heap.make<TachyonVec>(v));
+}
+
+TachyonVal TachyonVal::make_func(const std::function<TachyonVal(TachyonArgs)>& f, std::initializer_list<TachyonVal> captures) {
+    return TachyonVal::make_ptr(tachyon_heap.make<TachyonFunc>(f, captures));
+}
+
+std::string TachyonVal::str() const {
+    if (tag() == NIL) {
+        return "nil";
+    }
+    else if (tag() == NUM) {
+        std::ostringstream oss;
+        oss << n();
+        return oss.str();
+    }
+    else if (tag() == BOOL) {
+        return b() ? "true" : "false";
+    }
+    else if (tag() == CHAR) {
+        return std::string(1, c());
+    }
+    else if (tag() == OBJECT) {
+        if ((o()->get("proto") == String).b()) {
+            return static_cast<TachyonString*>(o())->s;
+        }
+        std::ostringstream oss;
+        oss << o();
+        return oss.str();
+    }
+    return "";
+}
+
+static std::mutex shape_mutex;
+
+TachyonShape::TachyonShape()
+    : proto_slot(-1) {
+}
+
+TachyonShape* TachyonShape::root() {
+    static TachyonShape* shape = new TachyonShape();
+    return shape;
+}
+
+TachyonShape* TachyonShape::add(const std::string& key) {
+    std::lock_guard<std::mutex> lock(shape_mutex);
+    std::unordered_map<std::string, TachyonShape*>::iterator it = transitions.find(key);
+    if (it != transitions.end()) {
+        return it->second;
+    }
+    TachyonShape* shape = new TachyonShape();
+    shape->slots = slots;
+    shape->slots[key] = slots.size();
+    shape->proto_slot = (key == "proto") ? slots.size() : proto_slot;
+    transitions[key] = shape;
+    return shape;
+}
+
+int TachyonShape::find(const std::string& key) const {
+    std::unordered_map<std::string, std::size_t>::const_iterator it = slots.find(key);
+    if (it == slots.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+TachyonSlots::TachyonSlots()
+    : vals(nullptr), count(0), capacity(0) {
+}
+
+TachyonSlots::TachyonSlots(TachyonSlots&& other)
+    : vals(other.vals), count(other.count), capacity(other.capacity) {
+    other.vals = nullptr;
+    other.count = 0;
+    other.capacity = 0;
+}
+
+TachyonSlots::~TachyonSlots() {
+    if (vals) {
+        TachyonAllocator().deallocate(vals, capacity);
+    }
+}
+
+// The new array is filled before it is published, so a reader that sees it sees its contents
+void TachyonSlots::reserve(std::size_t n) {
+    if (n <= capacity) {
+        return;
+    }
+    TachyonVal* grown = TachyonAllocator().allocate(n);
+    std::copy(vals, vals + count, grown);
+    TachyonVal* old = vals;
+    std::size_t old_capacity = capacity;
+    __atomic_store_n(&vals, grown, __ATOMIC_RELEASE);
+    capacity = n;
+    if (!old) {
+        return;
+    }
+    if (tachyon_threaded.load(std::memory_order_relaxed)) {
+        tachyon_heap.retire(old, old_capacity);
+    }
+    else {
+        TachyonAllocator().deallocate(old, old_capacity);
+    }
+}
+
+void TachyonSlots::push_back(const TachyonVal& val) {
+    if (count == capacity) {
+        reserve(capacity ? capacity * 2 : 1);
+    }
+    vals[count++] = val;
+}
+
+TachyonObject::TachyonObject()
+    : shape(TachyonShape::root()), next(nullptr), chunk(nullptr), bytes(0), marked(false), young(false), pinned(false), remembered(false), watched(false), seq(0) {
+}
+
+TachyonObject::TachyonObject(const std::map<std::string, TachyonVal>& map)
+    : shape(TachyonShape::root()), next(nullptr), chunk(nullptr), bytes(0), marked(false), young(false), pinned(false), remembered(false), watched(false), seq(0) {
+    slots.reserve(map.size());
+    for (const std::pair<const std::string, TachyonVal>& member : map) {
+        shape = shape->add(member.first);
+        slots.push_back(member.second);
+    }
+}
+
+// Objects are only moved by the collector, while no other thread can be using them
+TachyonObject::TachyonObject(TachyonObject&& other)
+    : shape(other.shape), slots(std::move(other.slots)), next(other.next), chunk(other.chunk), bytes(other.bytes), marked(other.marked), young(other.young), pinned(other.pinned), remembered(other.remembered), watched(other.watched.load(std::memory_order_relaxed)), seq(other.seq.load(std::memory_order_relaxed)) {
+}
+
+std::size_t TachyonObject::size() const {
+    return sizeof(TachyonObject);
+}
+
+TachyonObject* TachyonObject::move_to(void* mem) {
+    return new(mem) TachyonObject(std::move(*this));
+}
+
+void TachyonObject::trace(std::vector<TachyonVal*>& refs) {
+    for (TachyonVal& val : slots) {
+        if (val.tag() == TachyonVal::OBJECT) {
+            refs.push_back(&val);
+        }
+    }
+}
+
+TachyonVal TachyonObject::get(const std::string& key) const {
+    const TachyonObject* obj = this;
+    while (true) {
+        TachyonShape* found_shape;
+        TachyonVal val;
+        if (obj->read(key, found_shape, val) != -1) {
+            return val;
+        }
+        if (found_shape->proto_slot == -1) {
+            throw std::out_of_range("no member named '" + key + "'");
+        }
+        obj = val.o();
+    }
+}
+
+// Looks key up in this object alone, without locking. Returns its slot and value, or -1 and the
+// proto if the object has one. The shape they were read under is stored in found_shape.
+int TachyonObject::read(const std::string& key, TachyonShape*& found_shape, TachyonVal& val) const {
+    while (true) {
+        unsigned start = read_begin();
+        found_shape = load_shape();
+        int slot = found_shape->find(key);
+        int from = (slot != -1) ? slot : found_shape->proto_slot;
+        if (from != -1) {
+            val = slots.load(from);
+        }
+        if (read_end(start)) {
+            return slot;
+        }
+    }
+}
+
+// The new member's slot is filled before the shape that has it is published
+TachyonVal TachyonObject::set(const std::string& key, const TachyonVal& val) {
+    std::unique_lock<const TachyonObject> lock(*this, std::defer_lock);
+    if (tachyon_threaded.load(std::memory_order_relaxed)) {
+        lock.lock();
+    }
+    int slot = shape->find(key);
+    if (slot != -1) {
+        slots.store(slot, val);
+    }
+    else {
+        TachyonShape* next = shape->add(key);
+        slots.push_back(val);
+        __atomic_store_n(&shape, next, __ATOMIC_RELEASE);
+    }
+    // Old objects pointing into the nursery are roots for the next minor collection
+    if (!young && val.tag() == TachyonVal::OBJECT && val.o()->young) {
+        tachyon_heap.remember(this);
+    }
+    if (watched.load(std::memory_order_relaxed)) {
+        tachyon_epoch.fetch_add(1, std::memory_order_release);
+    }
+    return val;
+}
+
+// Waits out a writer. Writers never reach a safepoint while they hold the lock, but a collection
+// another thread asks for meanwhile shouldn't have to wait for this one to stop spinning.
+unsigned TachyonObject::read_wait() const {
+    unsigned start = seq.load(std::memory_order_acquire);
+    while (start & 1) {
+        tachyon_heap.safepoint();
+        std::this_thread::yield();
+        start = seq.load(std::memory_order_acquire);
+    }
+    return start;
+}
+
+void TachyonObject::lock() const {
+    unsigned start = seq.load(std::memory_order_relaxed);
+    while ((start & 1) || !seq.compare_exchange_weak(start, start + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+        tachyon_heap.safepoint();
+        std::this_thread::yield();
+        start = seq.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void TachyonObject::unlock() const {
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Each object along the chain is read optimistically: its shape and one slot are loaded, then
+// thrown away and read again if a write to the object overlapped
+TachyonVal TachyonCache::get_shared(const TachyonObject* obj, const char* key) {
+    const TachyonObject* holder = obj;
+    std::size_t i = 0;
+    while (i <= depth) {
+        unsigned start = holder->read_begin();
+        TachyonShape* shape = holder->load_shape();
+        if (shape != shapes[i]) {
+            break;
+        }
+        TachyonVal val = holder->slots.load(i == depth ? slot : shape->proto_slot);
+        if (!holder->read_end(start)) {
+            continue;
+        }
+        if (i == depth) {
+            return val;
+        }
+        holder = val.o();
+        i++;
+    }
+    return update(obj, key);
+}
+
+TachyonVal TachyonCache::update(const TachyonObject* obj, const char* key) {
+    std::string name(key);
+    const TachyonObject* holder = obj;
+    for (std::size_t i = 0; i < TACHYON_CACHE_DEPTH; i++) {
+        TachyonVal val;
+        int found = holder->read(name, shapes[i], val);
+        if (found != -1) {
+            depth = i;
+            slot = found;
+            return val;
+        }
+        if (shapes[i]->proto_slot == -1) {
+            break;
+        }
+        holder = val.o();
+    }
+    shapes[0] = nullptr;
+    return obj->get(name);
+}
+
+TachyonHoist::TachyonHoist()
+    : obj(nullptr), epoch(0), val(TachyonVal::make_nil()) {
+}
+
+// The epoch is read before the objects the lookup goes through are watched, and the value after.
+// A write to one of them that comes before it is watched is seen by the value, and any later
+// write bumps the epoch. Setting watched is the only part that takes an object's lock, and only
+// the first time, so writers that check it under their lock can't miss it.
+TachyonVal TachyonHoist::reload(TachyonCache& cache, const TachyonObject* obj, const char* key) {
+    epoch = tachyon_epoch.load(std::memory_order_acquire);
+    std::string name(key);
+    const TachyonObject* holder = obj;
+    while (true) {
+        if (!holder->watched.load(std::memory_order_acquire)) {
+            std::unique_lock<const TachyonObject> lock(*holder, std::defer_lock);
+            if (tachyon_threaded.load(std::memory_order_relaxed)) {
+                lock.lock();
+            }
+            holder->watched.store(true, std::memory_order_release);
+        }
+        TachyonShape* found_shape;
+        TachyonVal proto;
+        if (holder->read(name, found_shape, proto) != -1 || found_shape->proto_slot == -1) {
+            break;
+        }
+        holder = proto.o();
+    }
+    val = cache.get(obj, key);
+    this->obj = obj;
+    return val;
+}
+
+TachyonString::TachyonString(const std::string& s)
+    : s(s) {
+    set("proto", String);
+}
+
+std::size_t TachyonString::size() const {
+    return sizeof(TachyonString);
+}
+
+TachyonObject* TachyonString::move_to(void* mem) {
+    return new(mem) TachyonString(std::move(*this));
+}
+
+TachyonVec::TachyonVec(const TachyonVals& v)
+    : v(v) {
+    set("proto", Vec);
+}
+
+std::size_t TachyonVec::size() const {
+    return sizeof(TachyonVec);
+}
+
+TachyonObject* TachyonVec::move_to(void* mem) {
+    return new(mem) TachyonVec(std::move(*this));
+}
+
+void TachyonVec::trace(std::vector<TachyonVal*>& refs) {
+    TachyonObject::trace(refs);
+    for (TachyonVal& val : v) {
+        if (val.tag() == TachyonVal::OBJECT) {
+            refs.push_back(&val);
+        }
+    }
+}
+
+TachyonFunc::TachyonFunc(const std::function<TachyonVal(TachyonArgs)>& f, std::initializer_list<TachyonVal> captures)
+    : f(f), captures(captures) {
+    set("proto", Func);
+}
+
+std::size_t TachyonFunc::size() const {
+    return sizeof(TachyonFunc);
+}
+
+TachyonObject* TachyonFunc::move_to(void* mem) {
+    return new(mem) TachyonFunc(std::move(*this));
+}
+
+void TachyonFunc::trace(std::vector<TachyonVal*>& refs) {
+    TachyonObject::trace(refs);
+    for (TachyonVal& val : captures) {
+        if (val.tag() == TachyonVal::OBJECT) {
+            refs.push_back(&val);
+        }
+    }
+}
+
+TachyonEnv::TachyonEnv(std::size_t count)
+    : vals(count, TachyonVal::make_nil()) {
+}
+
+std::size_t TachyonEnv::size() const {
+    return sizeof(TachyonEnv);
+}
+
+TachyonObject* TachyonEnv::move_to(void* mem) {
+    return new(mem) TachyonEnv(std::move(*this));
+}
+
+void TachyonEnv::trace(std::vector<TachyonVal*>& refs) {
+    TachyonObject::trace(refs);
+    for (TachyonVal& val : vals) {
+        if (val.tag() == TachyonVal::OBJECT) {
+            refs.push_back(&val);
+        }
+    }
+}
+
+TachyonVal& TachyonEnv::put(std::size_t i, const TachyonVal& val) {
+    vals[i] = val;
+    if (!young && val.tag() == TachyonVal::OBJECT && val.o()->young) {
+        tachyon_heap.remember(this);
+    }
+    return vals[i];
+}
+
+TachyonThread::TachyonThread(const std::shared_ptr<TachyonTask>& task, const TachyonVal& proto)
+    : task(task) {
+    set("proto", proto);
+}
+
+std::size_t TachyonThread::size() const {
+    return sizeof(TachyonThread);
+}
+
+TachyonObject* TachyonThread::move_to(void* mem) {
+    return new(mem) TachyonThread(std::move(*this));
+}
+
+TachyonTask::TachyonTask(const TachyonVal& func)
+    : func(func), result(TachyonVal::make_nil()), done(false) {
+}
+
+TachyonTask::TachyonTask(const std::function<void()>& work)
+    : func(TachyonVal::make_nil()), work(work), result(TachyonVal::make_nil()), done(false) {
+}
+
+TachyonTask::~TachyonTask() {
+    tachyon_heap.remove_task(this);
+}
+
+// Called on a mutator, so the collector can't run while the results are stored
+void TachyonTask::run() {
+    try {
+        if (work) {
+            work();
+        }
+        else {
+            TachyonVal f = func;
+            result = f({});
+        }
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    func = TachyonVal::make_nil();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cv.notify_all();
+}
+
+TachyonPool::TachyonPool(std::size_t size)
+    : queued(0), next(0) {
+    for (std::size_t i = 0; i < size; i++) {
+        workers.push_back(new TachyonWorker());
+    }
+    for (TachyonWorker* worker : workers) {
+        std::thread([this, worker]() {
+            work(worker);
+        }).detach();
+    }
+}
+
+// Never destroyed, since workers may still be running when the program exits
+TachyonPool& TachyonPool::get() {
+    static TachyonPool* pool = []() {
+        tachyon_threaded = true;
+        std::size_t size = std::thread::hardware_concurrency();
+        if (const char* env = std::getenv("TACHYON_THREADS")) {
+            size = std::strtoull(env, nullptr, 10);
+        }
+        return new TachyonPool(std::max<std::size_t>(size, 1));
+    }();
+    return *pool;
+}
+
+std::shared_ptr<TachyonTask> TachyonPool::spawn(const TachyonVal& func) {
+    std::shared_ptr<TachyonTask> task(new TachyonTask(func));
+    push(task);
+    return task;
+}
+
+std::shared_ptr<TachyonTask> TachyonPool::spawn(const std::function<void()>& work) {
+    std::shared_ptr<TachyonTask> task(new TachyonTask(work));
+    push(task);
+    return task;
+}
+
+// Tasks spawned by a worker go on its own deque, others are spread over the workers in turn
+void TachyonPool::push(const std::shared_ptr<TachyonTask>& task) {
+    tachyon_heap.add_task(task.get());
+    TachyonWorker* worker = tachyon_current_worker;
+    if (!worker) {
+        worker = workers[next++ % workers.size()];
+    }
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->tasks.push_back(task);
+    }
+    queued++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    cv.notify_one();
+}
+
+// The newest task of the calling worker's deque, or else the oldest of another's
+std::shared_ptr<TachyonTask> TachyonPool::take() {
+    std::shared_ptr<TachyonTask> task;
+    if (!queued) {
+        return task;
+    }
+    TachyonWorker* own = tachyon_current_worker;
+    if (own) {
+        std::lock_guard<std::mutex> lock(own->mutex);
+        if (!own->tasks.empty()) {
+            task = own->tasks.back();
+            own->tasks.pop_back();
+            queued--;
+            return task;
+        }
+    }
+    std::size_t start = next++;
+    for (std::size_t i = 0; i < workers.size(); i++) {
+        TachyonWorker* victim = workers[(start + i) % workers.size()];
+        if (victim == own) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->tasks.empty()) {
+            task = victim->tasks.front();
+            victim->tasks.pop_front();
+            queued--;
+            return task;
+        }
+    }
+    return task;
+}
+
+bool TachyonPool::run_one() {
+    std::shared_ptr<TachyonTask> task = take();
+    if (!task) {
+        return false;
+    }
+    task->run();
+    return true;
+}
+
+// Runs other tasks until this one is done. Once there are none left it waits parked, checking
+// back every millisecond, since new tasks may be spawned by the one it is waiting for.
+void TachyonPool::join(TachyonTask* task) {
+    while (!task->done) {
+        if (run_one()) {
+            continue;
+        }
+        tachyon_heap.blocking([task]() {
+            std::unique_lock<std::mutex> lock(task->mutex);
+            task->cv.wait_for(lock, std::chrono::milliseconds(1), [task]() { return task->done.load(); });
+        });
+    }
+}
+
+// Four chunks per worker, so a worker that gets slow elements doesn't hold up the rest
+std::size_t TachyonPool::default_grain(std::size_t count) const {
+    return std::max<std::size_t>(count / (workers.size() * 4), 1);
+}
+
+// Calls f(begin, end) on consecutive chunks of [0, count) of grain indices each, spread over the
+// pool, and returns once all of them have run. The calling thread runs the first chunk itself.
+// If chunks throw, the exception of the first of them is rethrown.
+void TachyonPool::parallel_for(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& f) {
+    if (!count) {
+        return;
+    }
+    std::vector<std::shared_ptr<TachyonTask> > tasks;
+    for (std::size_t begin = grain; begin < count; begin += grain) {
+        std::size_t end = std::min(count, begin + grain);
+        tasks.push_back(spawn([&f, begin, end]() {
+            f(begin, end);
+        }));
+    }
+    std::exception_ptr error;
+    try {
+        f(0, std::min(count, grain));
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    for (const std::shared_ptr<TachyonTask>& task : tasks) {
+        join(task.get());
+        if (!error && task->error) {
+            error = task->error;
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void TachyonPool::work(TachyonWorker* worker) {
+    tachyon_current_worker = worker;
+    TachyonMutator* mutator = new TachyonMutator();
+    tachyon_heap.attach(mutator);
+    while (true) {
+        if (!run_one()) {
+            tachyon_heap.blocking([this]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]() { return queued > 0; });
+            });
+        }
+        tachyon_heap.safepoint();
+    }
+}
+
+static char* tachyon_stack_top() {
+#if defined(_WIN32)
+    return (char*)((NT_TIB*)NtCurrentTeb())->StackBase;
+#elif defined(__APPLE__)
+    return (char*)pthread_get_stackaddr_np(pthread_self());
+#else
+    pthread_attr_t attr;
+    void* addr;
+    std::size_t size;
+    pthread_getattr_np(pthread_self(), &attr);
+    pthread_attr_getstack(&attr, &addr, &size);
+    pthread_attr_destroy(&attr);
+    return (char*)addr + size;
+#endif
+}
+
+char* TachyonBuffer::begin() {
+    return (char*)(this + 1);
+}
+
+char* TachyonBuffer::end() {
+    return begin() + bytes;
+}
+
+TachyonChunk::TachyonChunk()
+    : top(begin()), pinned(0) {
+}
+
+char* TachyonChunk::begin() {
+    return (char*)(this + 1);
+}
+
+char* TachyonChunk::end() {
+    return (char*)this + TACHYON_CHUNK_SIZE;
+}
+
+TachyonMutator::TachyonMutator()
+    : stack_top(nullptr), stack_bottom(nullptr), parked(true), allocating(false), root(TachyonVal::make_nil()), chunk(nullptr) {
+}
+
+TachyonHeap::TachyonHeap()
+    : objects(nullptr), requested(false), bytes(0), threshold(0), heap_size(8 << 20), nursery_size(4 << 20), trigger_ratio(2.0), started(false) {
+    buffers.prev = &buffers;
+    buffers.next = &buffers;
+    if (const char* env = std::getenv("TACHYON_GC_HEAP_SIZE")) {
+        heap_size = std::strtoull(env, nullptr, 10);
+    }
+    if (const char* env = std::getenv("TACHYON_GC_NURSERY_SIZE")) {
+        nursery_size = std::strtoull(env, nullptr, 10);
+    }
+    if (const char* env = std::getenv("TACHYON_GC_TRIGGER_RATIO")) {
+        trigger_ratio = std::atof(env);
+    }
+    threshold = heap_size;
+}
+
+// Returns memory for an object of the given size, bumped from the calling thread's nursery chunk
+// when it has one. Objects allocated outside of a mutator go straight to the old generation.
+void* TachyonHeap::reserve(std::size_t size) {
+    TachyonMutator* m = tachyon_current_mutator;
+    size = TACHYON_ALIGN(size);
+    if (!m || size > TACHYON_CHUNK_SIZE - sizeof(TachyonChunk)) {
+        return ::operator new(size);
+    }
+    while (!m->chunk || m->chunk->top + size > m->chunk->end()) {
+        if (!refill(m)) {
+            collect();
+        }
+    }
+    m->allocating = true;
+    return m->chunk->top;
+}
+
+void TachyonHeap::release(void* mem) {
+    TachyonMutator* m = tachyon_current_mutator;
+    if (m && m->allocating) {
+        m->allocating = false;
+    }
+    else {
+        ::operator delete(mem);
+    }
+}
+
+TachyonObject* TachyonHeap::add(TachyonObject* o) {
+    o->bytes = o->size();
+    TachyonMutator* m = tachyon_current_mutator;
+    if (m && m->allocating) {
+        o->young = true;
+        m->chunk->top += TACHYON_ALIGN(o->bytes);
+        m->allocating = false;
+        safepoint();
+        return o;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!started) {
+            statics.push_back(o);
+            return o;
+        }
+        o->next = objects;
+        objects = o;
+    }
+    // Its members may already point into the nursery
+    remember(o);
+    if (bytes.fetch_add(o->bytes) + o->bytes > threshold && m) {
+        collect();
+    }
+    return o;
+}
+
+// Hands the mutator a fresh chunk, or returns false if the nursery is used up
+bool TachyonHeap::refill(TachyonMutator* m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!chunks.empty() && chunks.size() * TACHYON_CHUNK_SIZE >= nursery_size) {
+        return false;
+    }
+    TachyonChunk* chunk;
+    if (free_chunks.empty()) {
+        chunk = new(::operator new(TACHYON_CHUNK_SIZE)) TachyonChunk();
+    }
+    else {
+        chunk = free_chunks.back();
+        free_chunks.pop_back();
+    }
+    chunks.push_back(chunk);
+    m->chunk = chunk;
+    return true;
+}
+
+void TachyonHeap::remember(TachyonObject* o) {
+    if (o->remembered) {
+        return;
+    }
+    o->remembered = true;
+    if (TachyonMutator* m = tachyon_current_mutator) {
+        m->remembered.push_back(o);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    remembered.push_back(o);
+}
+
+void TachyonHeap::add_buffer(TachyonBuffer* buffer) {
+    std::lock_guard<std::mutex> lock(buffer_mutex);
+    buffer->prev = &buffers;
+    buffer->next = buffers.next;
+    buffers.next->prev = buffer;
+    buffers.next = buffer;
+}
+
+void TachyonHeap::remove_buffer(TachyonBuffer* buffer) {
+    std::lock_guard<std::mutex> lock(buffer_mutex);
+    buffer->prev->next = buffer->next;
+    buffer->next->prev = buffer->prev;
+}
+
+void TachyonHeap::add_task(TachyonTask* task) {
+    std::lock_guard<std::mutex> lock(task_mutex);
+    tasks.insert(task);
+}
+
+void TachyonHeap::remove_task(TachyonTask* task) {
+    std::lock_guard<std::mutex> lock(task_mutex);
+    tasks.erase(task);
+}
+
+void TachyonHeap::retire(TachyonVal* vals, std::size_t capacity) {
+    std::lock_guard<std::mutex> lock(retire_mutex);
+    retired.push_back(std::make_pair(vals, capacity));
+}
+
+void TachyonHeap::add_mutator(TachyonMutator* m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    mutators.push_back(m);
+}
+
+void TachyonHeap::attach(TachyonMutator* m) {
+    tachyon_current_mutator = m;
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !requested; });
+    if (std::find(mutators.begin(), mutators.end(), m) == mutators.end()) {
+        mutators.push_back(m);
+    }
+    m->stack_top = tachyon_stack_top();
+    m->parked = false;
+    started = true;
+}
+
+void TachyonHeap::detach(TachyonMutator* m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    remembered.insert(remembered.end(), m->remembered.begin(), m->remembered.end());
+    m->remembered.clear();
+    m->chunk = nullptr;
+    mutators.erase(std::find(mutators.begin(), mutators.end(), m));
+    tachyon_current_mutator = nullptr;
+    cv.notify_all();
+}
+
+void TachyonHeap::configure(std::size_t heap_size, double trigger_ratio) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->heap_size = heap_size;
+    this->trigger_ratio = trigger_ratio;
+    threshold = std::max(heap_size, (std::size_t)(bytes * trigger_ratio));
+}
+
+// Spills callee-saved registers into this frame so the collector sees them on the stack
+__attribute__((noinline)) void TachyonHeap::park() {
+    __builtin_unwind_init();
+    park_here();
+    asm volatile("" ::: "memory");
+}
+
+__attribute__((noinline)) void TachyonHeap::park_here() {
+    char bottom;
+    TachyonMutator* m = tachyon_current_mutator;
+    if (!m || m->allocating) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    m->stack_bottom = &bottom;
+    m->parked = true;
+    cv.notify_all();
+    cv.wait(lock, [this]() { return !requested; });
+    m->parked = false;
+}
+
+// Runs f with the calling thread parked, for builtins that may block
+__attribute__((noinline)) void TachyonHeap::blocking(const std::function<void()>& f) {
+    __builtin_unwind_init();
+    blocking_here(f);
+    asm volatile("" ::: "memory");
+}
+
+__attribute__((noinline)) void TachyonHeap::blocking_here(const std::function<void()>& f) {
+    char bottom;
+    TachyonMutator* m = tachyon_current_mutator;
+    if (!m) {
+        f();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        m->stack_bottom = &bottom;
+        m->parked = true;
+        cv.notify_all();
+    }
+    try {
+        f();
+    }
+    catch (...) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return !requested; });
+        m->parked = false;
+        throw;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !requested; });
+    m->parked = false;
+}
+
+__attribute__((noinline)) void TachyonHeap::collect(bool full) {
+    __builtin_unwind_init();
+    collect_here(full);
+    asm volatile("" ::: "memory");
+}
+
+__attribute__((noinline)) void TachyonHeap::collect_here(bool full) {
+    char bottom;
+    TachyonMutator* m = tachyon_current_mutator;
+    if (!m) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    m->stack_bottom = &bottom;
+    m->parked = true;
+    if (requested) {
+        // Another thread is already collecting
+        cv.notify_all();
+        cv.wait(lock, [this]() { return !requested; });
+        m->parked = false;
+        return;
+    }
+    requested = true;
+    cv.wait(lock, [this]() {
+        for (TachyonMutator* mutator : mutators) {
+            if (!mutator->parked) {
+                return false;
+            }
+        }
+        return true;
+    });
+    minor();
+    if (full || bytes > threshold) {
+        mark();
+        std::size_t live = 0;
+        sweep(&objects, live);
+        for (TachyonObject* o : statics) {
+            o->marked = false;
+        }
+        bytes = live;
+        threshold = std::max(heap_size, (std::size_t)(live * trigger_ratio));
+    }
+    requested = false;
+    m->parked = false;
+    cv.notify_all();
+}
+
+// Empties the nursery. Young objects found by the conservative stack scan are pinned and
+// promoted in place, since the words referring to them cannot be rewritten. Everything else
+// reachable from the mutator roots and the remembered set is moved to the old generation, so
+// the work done is proportional to the surviving objects plus a destructor pass over the nursery.
+void TachyonHeap::minor() {
+    {
+        // Every thread is parked outside any member read, so no one can still be using these
+        std::lock_guard<std::mutex> lock(retire_mutex);
+        for (const std::pair<TachyonVal*, std::size_t>& vals : retired) {
+            TachyonAllocator().deallocate(vals.first, vals.second);
+        }
+        retired.clear();
+    }
+    std::sort(chunks.begin(), chunks.end());
+    std::vector<TachyonObject*> young;
+    for (TachyonChunk* chunk : chunks) {
+        for (char* p = chunk->begin(); p < chunk->top; p += TACHYON_ALIGN(((TachyonObject*)p)->size())) {
+            young.push_back((TachyonObject*)p);
+        }
+    }
+    std::vector<TachyonObject*> pinned;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex);
+        std::vector<TachyonBuffer*> sorted;
+        sorted_buffers(sorted);
+        std::vector<bool> scanned(sorted.size());
+        for (TachyonMutator* mutator : mutators) {
+            if (mutator->stack_top) {
+                scan(mutator->stack_bottom, mutator->stack_top, young, sorted, scanned, pinned);
+            }
+        }
+    }
+    std::vector<TachyonVal*> refs;
+    for (TachyonObject* o : pinned) {
+        if (!o->pinned) {
+            o->pinned = true;
+            o->trace(refs);
+        }
+    }
+    for (TachyonMutator* mutator : mutators) {
+        if (mutator->root.tag() == TachyonVal::OBJECT) {
+            refs.push_back(&mutator->root);
+        }
+        for (TachyonObject* o : mutator->remembered) {
+            o->trace(refs);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        for (TachyonTask* task : tasks) {
+            if (task->func.tag() == TachyonVal::OBJECT) {
+                refs.push_back(&task->func);
+            }
+            if (task->result.tag() == TachyonVal::OBJECT) {
+                refs.push_back(&task->result);
+            }
+        }
+    }
+    for (TachyonObject* o : remembered) {
+        o->trace(refs);
+    }
+    while (!refs.empty()) {
+        TachyonVal* ref = refs.back();
+        refs.pop_back();
+        TachyonObject* o = ref->o();
+        if (!o->young || o->pinned) {
+            continue;
+        }
+        if (!o->next) {
+            promote(o)->trace(refs);
+        }
+        *ref = TachyonVal::make_ptr(o->next);
+    }
+    for (TachyonChunk* chunk : chunks) {
+        char* p = chunk->begin();
+        while (p < chunk->top) {
+            TachyonObject* o = (TachyonObject*)p;
+            p += TACHYON_ALIGN(o->size());
+            if (o->pinned) {
+                o->young = false;
+                o->pinned = false;
+                o->chunk = chunk;
+                o->next = objects;
+                objects = o;
+                bytes += o->bytes;
+                chunk->pinned++;
+            }
+            else {
+                o->~TachyonObject();
+            }
+        }
+        // Chunks holding pinned objects leave the nursery until those objects die
+        if (!chunk->pinned) {
+            chunk->top = chunk->begin();
+            free_chunks.push_back(chunk);
+        }
+    }
+    chunks.clear();
+    for (TachyonMutator* mutator : mutators) {
+        mutator->chunk = nullptr;
+        for (TachyonObject* o : mutator->remembered) {
+            o->remembered = false;
+        }
+        mutator->remembered.clear();
+    }
+    for (TachyonObject* o : remembered) {
+        o->remembered = false;
+    }
+    remembered.clear();
+}
+
+// Moves a young object to the old generation, leaving a forwarding pointer behind
+TachyonObject* TachyonHeap::promote(TachyonObject* o) {
+    TachyonObject* copy = o->move_to(::operator new(o->size()));
+    copy->young = false;
+    copy->next = objects;
+    objects = copy;
+    bytes += copy->bytes;
+    o->next = copy;
+    return copy;
+}
+
+// Marks the old generation. Only runs right after a minor collection, when the nursery is empty.
+void TachyonHeap::mark() {
+    std::vector<TachyonObject*> sorted_objects;
+    for (TachyonObject* o = objects; o; o = o->next) {
+        sorted_objects.push_back(o);
+    }
+    std::sort(sorted_objects.begin(), sorted_objects.end());
+    std::vector<TachyonObject*> stack(statics);
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex);
+        std::vector<TachyonBuffer*> sorted;
+        sorted_buffers(sorted);
+        std::vector<bool> scanned(sorted.size());
+        for (TachyonMutator* mutator : mutators) {
+            if (mutator->root.tag() == TachyonVal::OBJECT) {
+                stack.push_back(mutator->root.o());
+            }
+            if (mutator->stack_top) {
+                scan(mutator->stack_bottom, mutator->stack_top, sorted_objects, sorted, scanned, stack);
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        for (TachyonTask* task : tasks) {
+            if (task->func.tag() == TachyonVal::OBJECT) {
+                stack.push_back(task->func.o());
+            }
+            if (task->result.tag() == TachyonVal::OBJECT) {
+                stack.push_back(task->result.o());
+            }
+        }
+    }
+    std::vector<TachyonVal*> refs;
+    while (true) {
+        TachyonObject* o;
+        if (!stack.empty()) {
+            o = stack.back();
+            stack.pop_back();
+        }
+        else if (!refs.empty()) {
+            o = refs.back()->o();
+            refs.pop_back();
+        }
+        else {
+            break;
+        }
+        if (!o->marked) {
+            o->marked = true;
+            o->trace(refs);
+        }
+    }
+}
+
+void TachyonHeap::sorted_buffers(std::vector<TachyonBuffer*>& sorted) {
+    for (TachyonBuffer* buffer = buffers.next; buffer != &buffers; buffer = buffer->next) {
+        sorted.push_back(buffer);
+    }
+    std::sort(sorted.begin(), sorted.end());
+}
+
+// Treats every aligned word in [begin, end) as a possible pointer into an object or value buffer.
+// Buffers that are hit are scanned the same way, once each.
+__attribute__((no_sanitize_address)) void TachyonHeap::scan(char* begin, char* end, const std::vector<TachyonObject*>& objects, const std::vector<TachyonBuffer*>& buffers, std::vector<bool>& scanned, std::vector<TachyonObject*>& stack) {
+    std::vector<std::pair<char*, char*> > ranges{{begin, end}};
+    while (!ranges.empty()) {
+        std::pair<char*, char*> range = ranges.back();
+        ranges.pop_back();
+        char* p = (char*)(((uintptr_t)range.first + sizeof(uintptr_t) - 1) & ~(uintptr_t)(sizeof(uintptr_t) - 1));
+        for (; p + sizeof(uintptr_t) <= range.second; p += sizeof(uintptr_t)) {
+            uintptr_t word = *(uintptr_t*)p;
+#ifdef TACHYON_NAN_BOXING
+            if (((uint64_t)word & (TACHYON_QNAN | TACHYON_SIGN_BIT)) == (TACHYON_QNAN | TACHYON_SIGN_BIT)) {
+                word = (uintptr_t)((uint64_t)word & TACHYON_PTR_MASK);
+            }
+#endif
+            char* ptr = (char*)word;
+            std::vector<TachyonObject*>::const_iterator o = std::upper_bound(objects.begin(), objects.end(), (TachyonObject*)ptr);
+            if (o != objects.begin() && ptr < (char*)*(o - 1) + (*(o - 1))->size()) {
+                stack.push_back(*(o - 1));
+                continue;
+            }
+            std::size_t i = std::upper_bound(buffers.begin(), buffers.end(), (TachyonBuffer*)ptr) - buffers.begin();
+            if (i != 0 && !scanned[i - 1] && ptr < buffers[i - 1]->end()) {
+                scanned[i - 1] = true;
+                ranges.push_back({buffers[i - 1]->begin(), buffers[i - 1]->end()});
+            }
+        }
+    }
+}
+
+void TachyonHeap::sweep(TachyonObject** list, std::size_t& live) {
+    TachyonObject** link = list;
+    while (*link) {
+        TachyonObject* o = *link;
+        if (o->marked) {
+            o->marked = false;
+            live += o->bytes;
+            link = &o->next;
+        }
+        else {
+            *link = o->next;
+            destroy(o);
+        }
+    }
+}
+
+// Objects pinned in a nursery chunk give their memory back with the chunk, once all of them are gone
+void TachyonHeap::destroy(TachyonObject* o) {
+    TachyonChunk* chunk = o->chunk;
+    if (!chunk) {
+        delete o;
+        return;
+    }
+    o->~TachyonObject();
+    if (--chunk->pinned == 0) {
+        ::operator delete(chunk);
+    }
+}
+
+// Never a safepoint, since the caller may be holding pointers into other buffers or objects
+TachyonVal* TachyonAllocator::allocate(std::size_t n) {
+    TachyonBuffer* buffer = static_cast<TachyonBuffer*>(::operator new(sizeof(TachyonBuffer) + n * sizeof(TachyonVal)));
+    buffer->bytes = n * sizeof(TachyonVal);
+    tachyon_heap.add_buffer(buffer);
+    return (TachyonVal*)buffer->begin();
+}
+
+void TachyonAllocator::deallocate(TachyonVal* p, std::size_t) {
+    TachyonBuffer* buffer = (TachyonBuffer*)p - 1;
+    tachyon_heap.remove_buffer(buffer);
+    ::operator delete(buffer);
+}
+
+static std::random_device rd;
+static std::mt19937 mt(rd());
+static std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+TachyonVal System = TachyonVal::make_object({
+    {"print", TachyonVal::make_func([](TachyonArgs args) {
+        std::cout << args.at(1).str() << '\n';
+        return TachyonVal::make_nil();
+    })},
+    {"input", TachyonVal::make_func([](TachyonArgs) {
+        std::string input;
+        tachyon_heap.blocking([&]() {
+            std::cin >> input;
+        });
+        return TachyonVal::make_str(input);
+    })},
+    {"exit", TachyonVal::make_func([](TachyonArgs) {
+        std::exit(0);
+        return TachyonVal::make_nil();
+    })},
+    {"time", TachyonVal::make_func([](TachyonArgs) {
+        return TachyonVal::make_num(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    })},
+    {"assert", TachyonVal::make_func([](TachyonArgs args) {
+        // Only read by the assert, which -ndebug compiles out
+        (void)args;
+        assert(args.at(1).tag() == TachyonVal::BOOL && args.at(1).b());
+        return TachyonVal::make_nil();
+
+    })},
+    });
+
+TachyonVal Math = TachyonVal::make_object({
+    {"PI", TachyonVal::make_num(3.14159265358979323846)},
+    {"E", TachyonVal::make_num(2.7182818284590452354)},
+    {"sin", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::sin(args.at(1).n()));
+    })},
+    {"cos", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::cos(args.at(1).n()));
+    })},
+    {"tan", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::tan(args.at(1).n()));
+    })},
+    {"asin", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::asin(args.at(1).n()));
+    })},
+    {"acos", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::acos(args.at(1).n()));
+    })},
+    {"atan", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::atan(args.at(1).n()));
+    })},
+    {"atan2", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM && args.at(2).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::atan2(args.at(1).n(), args.at(2).n()));
+    })},
+    {"exp", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::exp(args.at(1).n()));
+    })},
+    {"log", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::log(args.at(1).n()));
+    })},
+    {"sqrt", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::sqrt(args.at(1).n()));
+    })},
+    {"pow", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM && args.at(2).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::pow(args.at(1).n(), args.at(2).n()));
+    })},
+    {"ceil", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::ceil(args.at(1).n()));
+    })},
+    {"floor", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::floor(args.at(1).n()));
+    })},
+    {"round", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        return TachyonVal::make_num(std::round(args.at(1).n()));
+    })},
+    {"rand", TachyonVal::make_func([](TachyonArgs) {
+        return TachyonVal::make_num(dist(mt));
+    })}
+    });
+
+TachyonVal String = TachyonVal::make_object({
+    {"length", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT);
+        const std::string& str = static_cast<TachyonString*>(args.at(0).o())->s;
+        return TachyonVal::make_num(str.length());
+    })},
+    {"at", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::NUM);
+        const std::string& str = static_cast<TachyonString*>(args.at(0).o())->s;
+        return TachyonVal::make_char(str.at(args.at(1).n()));
+    })},
+    {"first", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT);
+        const std::string& str = static_cast<TachyonString*>(args.at(0).o())->s;
+        return TachyonVal::make_char(str.front());
+    })},
+    {"last", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT);
+        const std::string& str = static_cast<TachyonString*>(args.at(0).o())->s;
+        return TachyonVal::make_char(str.back());
+    })},
+    {"find", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::OBJECT);
+        const std::string& str = static_cast<TachyonString*>(args.at(0).o())->s;
+        const std::string& str2 = static_cast<TachyonString*>(args.at(1).o())->s;
+        return TachyonVal::make_num(str.find(str2));
+    })},
+    {"contains", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::OBJECT);
+        const std::string& str = static_cast<TachyonString*>(args.at(0).o())->s;
+        const std::string& str2 = static_cast<TachyonString*>(args.at(1).o())->s;
+        return TachyonVal::make_bool(str.find(str2) != std::string::npos);
+    })},
+    {"substr", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::NUM && args.at(2).tag() == TachyonVal::NUM);
+        const std::string& str = static_cast<TachyonString*>(args.at(0).o())->s;
+        return TachyonVal::make_str(str.substr(args.at(1).n(), args.at(2).n()));
+    })},
+    {"concat", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::OBJECT);
+        const std::string& str = static_cast<TachyonString*>(args.at(0).o())->s;
+        const std::string& str2 = static_cast<TachyonString*>(args.at(1).o())->s;
+        return TachyonVal::make_str(str + str2);
+    })},
+    {"split", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT);
+        std::string str = static_cast<TachyonString*>(args.at(0).o())->s;
+        std::string str2 = static_cast<TachyonString*>(args.at(1).o())->s;
+        std::string str3 = str;
+        TachyonVals list;
+        std::size_t pos = 0;
+        std::string token;
+        while ((pos = str3.find(str2)) != std::string::npos) {
+            token = str3.substr(0, pos);
+            list.push_back(TachyonVal::make_str(token));
+            str3.erase(0, pos + str2.length());
+        }
+        list.push_back(TachyonVal::make_str(str3));
+        return TachyonVal::make_vec(list);
+    })},
+    {"from", TachyonVal::make_func([](TachyonArgs args) {
+        return TachyonVal::make_str(args.at(1).str());
+    })}
+    });
+
+// The optional grain argument of the parallel Vec builtins, or else the pool's default. It is
+// checked even with -ndebug, since a grain of 0 would never finish. Fractions are rounded up to 1
+// and grains past count mean count, so the conversion to size_t is always defined.
+static std::size_t tachyon_grain(TachyonArgs args, std::size_t i, std::size_t count) {
+    if (args.size() <= i) {
+        return TachyonPool::get().default_grain(count);
+    }
+    const TachyonVal& grain = args.at(i);
+    if (grain.tag() != TachyonVal::NUM || !std::isfinite(grain.n()) || grain.n() < 0) {
+        throw std::invalid_argument("grain must be a finite, non-negative number");
+    }
+    return std::max<std::size_t>(std::min<double>(grain.n(), count), 1);
+}
+
+TachyonVal Vec = TachyonVal::make_object({
+    {"length", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT);
+        const TachyonVals& vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+        return TachyonVal::make_num(vec.size());
+    })},
+    {"at", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT);
+        assert(args.at(1).tag() == TachyonVal::NUM);
+        const TachyonVals& vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+        return vec.at(args.at(1).n());
+    })},
+    {"first", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT);
+        const TachyonVals& vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+        return vec.front();
+    })},
+    {"last", TachyonVal::make_func([](TachyonArgs args) {
+        assert(args.at(0).tag() == TachyonVal::OBJECT);
+        const TachyonVals& vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+        return vec.back();
+    })},
+    {"push", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(0).tag() == TachyonVal::OBJECT);
+    TachyonVals vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+    vec.push_back(args.at(1));
+    return TachyonVal::make_nil();
+    })},
+    {"pop", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(0).tag() == TachyonVal::OBJECT);
+    TachyonVals vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+    vec.pop_back();
+    return TachyonVal::make_nil();
+    })},
+    {"subvec", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::NUM && args.at(2).tag() == TachyonVal::NUM);
+    const TachyonVals& vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+    return TachyonVal::make_vec({vec.begin() + args.at(1).n(), vec.begin() + args.at(1).n() + args.at(2).n()});
+    })},
+    // The parallel builtins work on a copy of the elements, so the function can't change what is iterated over
+    {"parallelMap", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::OBJECT);
+    TachyonVals vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+    TachyonVals out(vec.size(), TachyonVal::make_nil());
+    TachyonPool::get().parallel_for(vec.size(), tachyon_grain(args, 2, vec.size()), [&](std::size_t begin, std::size_t end) {
+        TachyonVal f = args.at(1);
+        for (std::size_t i = begin; i < end; i++) {
+            out[i] = f({vec[i]});
+        }
+    });
+    return TachyonVal::make_vec(out);
+    })},
+    {"parallelForEach", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::OBJECT);
+    TachyonVals vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+    TachyonPool::get().parallel_for(vec.size(), tachyon_grain(args, 2, vec.size()), [&](std::size_t begin, std::size_t end) {
+        TachyonVal f = args.at(1);
+        for (std::size_t i = begin; i < end; i++) {
+            f({vec[i]});
+        }
+    });
+    return TachyonVal::make_nil();
+    })},
+    // Each chunk is folded from its first element, then init and the chunks' results are folded in order
+    {"parallelReduce", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(0).tag() == TachyonVal::OBJECT && args.at(1).tag() == TachyonVal::OBJECT);
+    TachyonVals vec = static_cast<TachyonVec*>(args.at(0).o())->v;
+    std::size_t grain = tachyon_grain(args, 3, vec.size());
+    TachyonVals partials((vec.size() + grain - 1) / grain, TachyonVal::make_nil());
+    TachyonPool::get().parallel_for(vec.size(), grain, [&](std::size_t begin, std::size_t end) {
+        TachyonVal f = args.at(1);
+        TachyonVal acc = vec[begin];
+        for (std::size_t i = begin + 1; i < end; i++) {
+            acc = f({acc, vec[i]});
+        }
+        partials[begin / grain] = acc;
+    });
+    TachyonVal f = args.at(1);
+    TachyonVal acc = args.at(2);
+    for (const TachyonVal& partial : partials) {
+        acc = f({acc, partial});
+    }
+    return acc;
+    })}
+    });
+
+TachyonVal Func = TachyonVal::make_object({});
+
+// Waits for the task of a handle and rethrows what it threw
+static TachyonTask* tachyon_join(const TachyonVal& handle) {
+    assert(handle.tag() == TachyonVal::OBJECT);
+    TachyonTask* task = static_cast<TachyonThread*>(handle.o())->task.get();
+    TachyonPool::get().join(task);
+    if (task->error) {
+        std::rethrow_exception(task->error);
+    }
+    return task;
+}
+
+TachyonVal Thread = TachyonVal::make_object({
+    {"create", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(1).tag() == TachyonVal::OBJECT);
+    return TachyonVal::make_thread(TachyonPool::get().spawn(args.at(1)), Thread);
+    })},
+    {"join", TachyonVal::make_func([](TachyonArgs args) {
+    tachyon_join(args.at(0));
+    return TachyonVal::make_nil();
+    })}
+    });
+
+TachyonVal Task = TachyonVal::make_object({
+    {"spawn", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(1).tag() == TachyonVal::OBJECT);
+    return TachyonVal::make_thread(TachyonPool::get().spawn(args.at(1)), Task);
+    })},
+    {"join", TachyonVal::make_func([](TachyonArgs args) {
+    return tachyon_join(args.at(0))->result;
+    })}
+    });
+
+TachyonVal FileSystem = TachyonVal::make_object({
+    {"read", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(1).tag() == TachyonVal::OBJECT);
+    std::string path = static_cast<TachyonString*>(args.at(1).o())->s;
+    std::ifstream in_file;
+    in_file.open(path);
+    std::stringstream strStream;
+    strStream << in_file.rdbuf();
+    std::string text = strStream.str();
+    return TachyonVal::make_str(text);
+    })},
+    {"write", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(1).tag() == TachyonVal::OBJECT && args.at(2).tag() == TachyonVal::OBJECT);
+    std::string path = static_cast<TachyonString*>(args.at(1).o())->s;
+    std::string str = static_cast<TachyonString*>(args.at(2).o())->s;
+    std::ofstream out_file;
+    out_file.open(path);
+    out_file << str;
+    return TachyonVal::make_nil();
+    })}
+    });
+
+TachyonVal Exception = TachyonVal::make_object({
+    {"throw", TachyonVal::make_func([](TachyonArgs args) {
+    std::string msg = static_cast<TachyonString*>(args.at(0).o()->get("msg").o())->s;
+    throw std::runtime_error(msg);
+    return TachyonVal::make_nil();
+    })}
+    });
+
+TachyonVal GC = TachyonVal::make_object({
+    {"collect", TachyonVal::make_func([](TachyonArgs) {
+    tachyon_heap.collect(true);
+    return TachyonVal::make_nil();
+    })},
+    {"setHeapSize", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(1).tag() == TachyonVal::NUM);
+    tachyon_heap.configure(args.at(1).n(), tachyon_heap.trigger_ratio);
+    return TachyonVal::make_nil();
+    })},
+    {"setTriggerRatio", TachyonVal::make_func([](TachyonArgs args) {
+    assert(args.at(1).tag() == TachyonVal::NUM);
+    tachyon_heap.configure(tachyon_heap.heap_size, args.at(1).n());
+    return TachyonVal::make_nil();
+    })},
+    {"bytes", TachyonVal::make_func([](TachyonArgs) {
+    return TachyonVal::make_num(tachyon_heap.bytes);
+    })}
+    });
\ No newline at end of file
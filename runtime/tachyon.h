@@ -0,0 +1,875 @@
+// Runtime shared by every program compiled with tachyonc. The definitions live in libtachyonrt,
+// except for the value operations the generated code calls in hot loops, which stay inline here.
+#ifndef TACHYON_H
+#define TACHYON_H
+
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <stdexcept>
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <condition_variable>
+#include <set>
+#include <deque>
+#include <memory>
+#include <exception>
+#include <new>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+class TachyonVal;
+class TachyonObject;
+class TachyonArgs;
+class TachyonFunc;
+class TachyonTask;
+
+// Allocator for buffers of values, which registers them with the collector so stack words pointing
+// into them are followed. Every container of values in the runtime uses it, through TachyonVals.
+class TachyonAllocator {
+public:
+    typedef TachyonVal value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+
+    template <class U>
+    struct rebind {
+        typedef TachyonAllocator other;
+    };
+
+    TachyonVal* allocate(std::size_t n);
+    void deallocate(TachyonVal* p, std::size_t n);
+};
+
+inline bool operator==(const TachyonAllocator&, const TachyonAllocator&) {
+    return true;
+}
+
+inline bool operator!=(const TachyonAllocator&, const TachyonAllocator&) {
+    return false;
+}
+
+typedef std::vector<TachyonVal, TachyonAllocator> TachyonVals;
+
+#ifdef TACHYON_NAN_BOXING
+// NaN-boxing layout: numbers are stored as plain doubles, every other value lives in the
+// payload of a quiet NaN. Objects set the sign bit and keep their 48-bit pointer in the
+// low bits, characters set bit 48, and nil/false/true are small constants.
+#define TACHYON_QNAN ((uint64_t)0x7ffc000000000000)
+#define TACHYON_SIGN_BIT ((uint64_t)0x8000000000000000)
+#define TACHYON_CHAR_BIT ((uint64_t)0x0001000000000000)
+#define TACHYON_PTR_MASK ((uint64_t)0x0000ffffffffffff)
+#define TACHYON_NIL_BITS (TACHYON_QNAN | 1)
+#define TACHYON_FALSE_BITS (TACHYON_QNAN | 2)
+#define TACHYON_TRUE_BITS (TACHYON_QNAN | 3)
+#define TACHYON_CANONICAL_NAN ((uint64_t)0x7ff8000000000000)
+#endif
+
+// Tagged union, or a NaN-boxed double if TACHYON_NAN_BOXING is defined
+class TachyonVal {
+public:
+    enum Tag {
+        NIL,
+        NUM,
+        BOOL,
+        CHAR,
+        OBJECT
+    };
+
+#ifdef TACHYON_NAN_BOXING
+    uint64_t bits;
+#else
+    Tag t;
+
+    union {
+        double num;
+        bool boolean;
+        char chr;
+        TachyonObject* obj;
+    };
+#endif
+
+    TachyonVal() = default;
+
+    Tag tag() const;
+    double n() const;
+    bool b() const;
+    char c() const;
+    TachyonObject* o() const;
+    static TachyonVal make_nil();
+    static TachyonVal make_num(double n);
+    static TachyonVal make_bool(bool b);
+    static TachyonVal make_char(char c);
+    static TachyonVal make_ptr(TachyonObject* o);
+    static TachyonVal make_object(const std::map<std::string, TachyonVal>& map);
+    static TachyonVal make_str(const std::string& s);
+    static TachyonVal make_vec(const TachyonVals& v);
+    static TachyonVal make_func(const std::function<TachyonVal(TachyonArgs)>& f, std::initializer_list<TachyonVal> captures = {});
+    static TachyonVal make_thread(const std::shared_ptr<TachyonTask>& task, const TachyonVal& proto);
+    TachyonVal operator+() const;
+    TachyonVal operator-() const;
+    TachyonVal operator+(const TachyonVal& other) const;
+    TachyonVal operator-(const TachyonVal& other) const;
+    TachyonVal operator*(const TachyonVal& other) const;
+    TachyonVal operator/(const TachyonVal& other) const;
+    TachyonVal operator%(const TachyonVal& other) const;
+    TachyonVal operator<<(const TachyonVal& other) const;
+    TachyonVal operator>>(const TachyonVal& other) const;
+    TachyonVal operator&(const TachyonVal& other) const;
+    TachyonVal operator|(const TachyonVal& other) const;
+    TachyonVal operator^(const TachyonVal& other) const;
+    TachyonVal operator&&(const TachyonVal& other) const;
+    TachyonVal operator||(const TachyonVal& other) const;
+    TachyonVal operator<(const TachyonVal& other) const;
+    TachyonVal operator<=(const TachyonVal& other) const;
+    TachyonVal operator>(const TachyonVal& other) const;
+    TachyonVal operator>=(const TachyonVal& other) const;
+    TachyonVal operator==(const TachyonVal& other) const;
+    TachyonVal operator!=(const TachyonVal& other) const;
+    TachyonVal operator()(TachyonArgs args);
+    std::string str() const;
+};
+
+// Arguments of a call, viewed in place in the caller's frame, with the receiver (if any) in slot 0.
+// func is the function being called, which is how a closure reaches what it captured.
+class TachyonArgs {
+public:
+    const TachyonVal* vals;
+    std::size_t count;
+    TachyonFunc* func;
+    TachyonArgs();
+    TachyonArgs(std::initializer_list<TachyonVal> list);
+    TachyonArgs(const TachyonVal* vals, std::size_t count);
+    std::size_t size() const;
+    const TachyonVal& at(std::size_t i) const;
+};
+
+extern TachyonVal System;
+extern TachyonVal Math;
+extern TachyonVal String;
+extern TachyonVal Vec;
+extern TachyonVal Func;
+extern TachyonVal Thread;
+extern TachyonVal Task;
+extern TachyonVal FileSystem;
+extern TachyonVal Exception;
+extern TachyonVal GC;
+
+// Hidden class shared by all objects whose members were added in the same order
+class TachyonShape {
+public:
+    std::unordered_map<std::string, std::size_t> slots{};
+    std::unordered_map<std::string, TachyonShape*> transitions{};
+    int proto_slot;
+    TachyonShape();
+    static TachyonShape* root();
+    TachyonShape* add(const std::string& key);
+    int find(const std::string& key) const;
+};
+
+// Set when the thread pool starts. Until then object members are read and written without any
+// synchronization, so single-threaded programs pay nothing for it.
+extern std::atomic<bool> tachyon_threaded;
+
+// Member values of an object. Once threads have started, readers may still be using the array
+// after it grows, so the old one is kept until the next collection, when no read can be in flight.
+class TachyonSlots {
+public:
+    TachyonVal* vals;
+    std::size_t count;
+    std::size_t capacity;
+    TachyonSlots();
+    TachyonSlots(TachyonSlots&& other);
+    ~TachyonSlots();
+    std::size_t size() const;
+    TachyonVal& operator[](std::size_t i);
+    const TachyonVal& operator[](std::size_t i) const;
+    TachyonVal* begin();
+    TachyonVal* end();
+    void reserve(std::size_t n);
+    void push_back(const TachyonVal& val);
+    TachyonVal load(std::size_t i) const;
+    void store(std::size_t i, const TachyonVal& val);
+};
+
+class TachyonChunk;
+
+// Once threads have started, members are guarded by a per-object seqlock: writers take it by
+// making seq odd and release it by making it even again, while readers never lock and retry if
+// seq changed meanwhile.
+class TachyonObject {
+public:
+    TachyonShape* shape;
+    TachyonSlots slots{};
+    // Link in the old generation's object list, or the forwarding pointer of an evacuated young object
+    TachyonObject* next;
+    TachyonChunk* chunk;
+    std::size_t bytes;
+    bool marked;
+    bool young;
+    bool pinned;
+    bool remembered;
+    // Set once a hoisted load depends on this object, after which writes to it bump tachyon_epoch
+    mutable std::atomic<bool> watched;
+    mutable std::atomic<unsigned> seq;
+    TachyonObject();
+    TachyonObject(const std::map<std::string, TachyonVal>& map);
+    TachyonObject(TachyonObject&& other);
+    virtual ~TachyonObject() = default;
+    virtual std::size_t size() const;
+    virtual TachyonObject* move_to(void* mem);
+    virtual void trace(std::vector<TachyonVal*>& refs);
+    TachyonVal get(const std::string& key) const;
+    TachyonVal set(const std::string& key, const TachyonVal& val);
+    int read(const std::string& key, TachyonShape*& found_shape, TachyonVal& val) const;
+    TachyonShape* load_shape() const;
+    unsigned read_begin() const;
+    unsigned read_wait() const;
+    bool read_end(unsigned start) const;
+    void lock() const;
+    void unlock() const;
+};
+
+#define TACHYON_CACHE_DEPTH 4
+
+// Inline cache for a single member access site, keyed on the shapes along the proto chain
+class TachyonCache {
+public:
+    TachyonShape* shapes[TACHYON_CACHE_DEPTH];
+    std::size_t depth;
+    std::size_t slot;
+    TachyonVal get(const TachyonObject* obj, const char* key);
+    TachyonVal get_shared(const TachyonObject* obj, const char* key);
+    TachyonVal update(const TachyonObject* obj, const char* key);
+    TachyonVal call(const char* key, TachyonArgs args);
+};
+
+// Counts writes to watched objects, so hoisted loads can tell when the members they read may have changed
+extern std::atomic<std::size_t> tachyon_epoch;
+
+// Member load hoisted out of a loop. The value is reused for as long as the receiver is the same
+// object and no object between it and the member's holder has been written to, which is checked
+// with one compare each. Hoisted loads live on the stack, so the scan pins what they point to.
+class TachyonHoist {
+public:
+    const TachyonObject* obj;
+    std::size_t epoch;
+    TachyonVal val;
+    TachyonHoist();
+    TachyonVal get(TachyonCache& cache, const TachyonObject* obj, const char* key);
+    TachyonVal call(TachyonCache& cache, const char* key, TachyonArgs args);
+    TachyonVal reload(TachyonCache& cache, const TachyonObject* obj, const char* key);
+};
+
+class TachyonString: public TachyonObject {
+public:
+    std::string s;
+    TachyonString(const std::string& s);
+    std::size_t size() const;
+    TachyonObject* move_to(void* mem);
+};
+
+class TachyonVec: public TachyonObject {
+public:
+    TachyonVals v;
+    TachyonVec(const TachyonVals& v);
+    std::size_t size() const;
+    TachyonObject* move_to(void* mem);
+    void trace(std::vector<TachyonVal*>& refs);
+};
+
+class TachyonFunc: public TachyonObject {
+public:
+    std::function<TachyonVal(TachyonArgs)> f;
+    TachyonVals captures;
+    TachyonFunc(const std::function<TachyonVal(TachyonArgs)>& f, std::initializer_list<TachyonVal> captures);
+    std::size_t size() const;
+    TachyonObject* move_to(void* mem);
+    void trace(std::vector<TachyonVal*>& refs);
+};
+
+// Variables shared by a scope and the closures created in it
+class TachyonEnv: public TachyonObject {
+public:
+    TachyonVals vals;
+    TachyonEnv(std::size_t count);
+    std::size_t size() const;
+    TachyonObject* move_to(void* mem);
+    void trace(std::vector<TachyonVal*>& refs);
+    TachyonVal& put(std::size_t i, const TachyonVal& val);
+};
+
+// Handle of a task started with Thread.create or Task.spawn
+class TachyonThread: public TachyonObject {
+public:
+    std::shared_ptr<TachyonTask> task;
+    TachyonThread(const std::shared_ptr<TachyonTask>& task, const TachyonVal& proto);
+    std::size_t size() const;
+    TachyonObject* move_to(void* mem);
+};
+
+// A function run by the pool. Its values are roots of the collector for as long as it exists,
+// which is until it has run and its handle has been collected. Runtime builtins can run C++ work
+// instead, which must keep what it uses reachable from the stack of the thread that joins it.
+class TachyonTask {
+public:
+    TachyonVal func;
+    std::function<void()> work;
+    TachyonVal result;
+    std::exception_ptr error;
+    std::atomic<bool> done;
+    std::mutex mutex;
+    std::condition_variable cv;
+    TachyonTask(const TachyonVal& func);
+    TachyonTask(const std::function<void()>& work);
+    ~TachyonTask();
+    void run();
+};
+
+class TachyonWorker {
+public:
+    std::mutex mutex;
+    std::deque<std::shared_ptr<TachyonTask> > tasks{};
+};
+
+// Work-stealing scheduler behind Thread.create and Task.spawn, started the first time either is
+// used with TACHYON_THREADS workers, or one per core. A worker pushes and pops the tasks it
+// spawns at the back of its own deque, and when that is empty steals from the front of the
+// others'. Threads waiting in join run queued tasks meanwhile, so a task can spawn and join
+// subtasks without starving the pool. Idle workers wait parked, so they never hold up a collection.
+class TachyonPool {
+public:
+    std::vector<TachyonWorker*> workers{};
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<std::size_t> queued;
+    std::atomic<std::size_t> next;
+    TachyonPool(std::size_t size);
+    static TachyonPool& get();
+    std::shared_ptr<TachyonTask> spawn(const TachyonVal& func);
+    std::shared_ptr<TachyonTask> spawn(const std::function<void()>& work);
+    void push(const std::shared_ptr<TachyonTask>& task);
+    std::shared_ptr<TachyonTask> take();
+    bool run_one();
+    void join(TachyonTask* task);
+    std::size_t default_grain(std::size_t count) const;
+    void parallel_for(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& f);
+    void work(TachyonWorker* worker);
+};
+
+// Header in front of every buffer of values, linking it into the collector's buffer list
+class TachyonBuffer {
+public:
+    TachyonBuffer* prev;
+    TachyonBuffer* next;
+    std::size_t bytes;
+    char* begin();
+    char* end();
+};
+
+#define TACHYON_CHUNK_SIZE (64 << 10)
+#define TACHYON_ALIGN(n) (((n) + 15) & ~(std::size_t)15)
+
+// Bump-pointer region of the nursery. Objects are laid out back to back from begin() up to top,
+// so a chunk is walked using each object's size().
+class TachyonChunk {
+public:
+    char* top;
+    std::size_t pinned;
+    TachyonChunk();
+    char* begin();
+    char* end();
+};
+
+// A thread running Tachyon code, with the stack range the collector scans while it is parked
+class TachyonMutator {
+public:
+    char* stack_top;
+    char* stack_bottom;
+    bool parked;
+    bool allocating;
+    TachyonVal root;
+    TachyonChunk* chunk;
+    std::vector<TachyonObject*> remembered{};
+    TachyonMutator();
+};
+
+// Stop-the-world generational collector. New objects are bump-allocated in the current thread's
+// nursery chunk, and a minor collection runs whenever the nursery is full. Old objects are
+// collected by mark-sweep once the old generation grows past the larger of heap_size and
+// trigger_ratio times the bytes that survived the last major collection. Mutator stacks are
+// scanned conservatively and objects are traced precisely.
+class TachyonHeap {
+public:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<TachyonMutator*> mutators{};
+    std::vector<TachyonObject*> statics{};
+    TachyonObject* objects;
+    std::vector<TachyonChunk*> chunks{};
+    std::vector<TachyonChunk*> free_chunks{};
+    std::vector<TachyonObject*> remembered{};
+    std::mutex buffer_mutex;
+    TachyonBuffer buffers;
+    std::mutex task_mutex;
+    std::set<TachyonTask*> tasks{};
+    std::mutex retire_mutex;
+    std::vector<std::pair<TachyonVal*, std::size_t>> retired{};
+    std::atomic<bool> requested;
+    std::atomic<std::size_t> bytes;
+    std::atomic<std::size_t> threshold;
+    std::size_t heap_size;
+    std::size_t nursery_size;
+    double trigger_ratio;
+    bool started;
+    TachyonHeap();
+    template <class T, class... Args>
+    T* make(Args&&... args);
+    void* reserve(std::size_t size);
+    void release(void* mem);
+    TachyonObject* add(TachyonObject* o);
+    bool refill(TachyonMutator* m);
+    void remember(TachyonObject* o);
+    void add_buffer(TachyonBuffer* buffer);
+    void remove_buffer(TachyonBuffer* buffer);
+    void add_task(TachyonTask* task);
+    void remove_task(TachyonTask* task);
+    void retire(TachyonVal* vals, std::size_t capacity);
+    void add_mutator(TachyonMutator* m);
+    void attach(TachyonMutator* m);
+    void detach(TachyonMutator* m);
+    void configure(std::size_t heap_size, double trigger_ratio);
+    void safepoint();
+    void park();
+    void park_here();
+    void blocking(const std::function<void()>& f);
+    void blocking_here(const std::function<void()>& f);
+    void collect(bool full = false);
+    void collect_here(bool full);
+    void minor();
+    TachyonObject* promote(TachyonObject* o);
+    void mark();
+    void sweep(TachyonObject** list, std::size_t& live);
+    void destroy(TachyonObject* o);
+    void sorted_buffers(std::vector<TachyonBuffer*>& sorted);
+    void scan(char* begin, char* end, const std::vector<TachyonObject*>& objects, const std::vector<TachyonBuffer*>& buffers, std::vector<bool>& scanned, std::vector<TachyonObject*>& stack);
+};
+
+extern TachyonHeap tachyon_heap;
+
+// Constructs a T in the nursery. Safepoints are held off until the object is committed, since the
+// collector only walks the committed part of a chunk.
+template <class T, class... Args>
+T* TachyonHeap::make(Args&&... args) {
+    void* mem = reserve(sizeof(T));
+    T* o;
+    try {
+        o = new(mem) T(std::forward<Args>(args)...);
+    }
+    catch (...) {
+        release(mem);
+        throw;
+    }
+    add(o);
+    return o;
+}
+
+#ifdef TACHYON_NAN_BOXING
+inline TachyonVal::Tag TachyonVal::tag() const {
+    if ((bits & TACHYON_QNAN) != TACHYON_QNAN) {
+        return NUM;
+    }
+    else if (bits & TACHYON_SIGN_BIT) {
+        return OBJECT;
+    }
+    else if (bits & TACHYON_CHAR_BIT) {
+        return CHAR;
+    }
+    else if (bits == TACHYON_NIL_BITS) {
+        return NIL;
+    }
+    return BOOL;
+}
+
+inline double TachyonVal::n() const {
+    double n;
+    std::memcpy(&n, &bits, sizeof(double));
+    return n;
+}
+
+inline bool TachyonVal::b() const {
+    return bits == TACHYON_TRUE_BITS;
+}
+
+inline char TachyonVal::c() const {
+    return (char)(bits & 0xff);
+}
+
+inline TachyonObject* TachyonVal::o() const {
+    return (TachyonObject*)(uintptr_t)(bits & TACHYON_PTR_MASK);
+}
+
+inline TachyonVal TachyonVal::make_nil() {
+    TachyonVal result;
+    result.bits = TACHYON_NIL_BITS;
+    return result;
+}
+
+inline TachyonVal TachyonVal::make_num(double n) {
+    TachyonVal result;
+    if (n != n) {
+        result.bits = TACHYON_CANONICAL_NAN;
+    }
+    else {
+        std::memcpy(&result.bits, &n, sizeof(double));
+    }
+    return result;
+}
+
+inline TachyonVal TachyonVal::make_bool(bool b) {
+    TachyonVal result;
+    result.bits = b ? TACHYON_TRUE_BITS : TACHYON_FALSE_BITS;
+    return result;
+}
+
+inline TachyonVal TachyonVal::make_char(char c) {
+    TachyonVal result;
+    result.bits = TACHYON_QNAN | TACHYON_CHAR_BIT | (unsigned char)c;
+    return result;
+}
+
+inline TachyonVal TachyonVal::make_ptr(TachyonObject* o) {
+    TachyonVal result;
+    result.bits = TACHYON_QNAN | TACHYON_SIGN_BIT | (uint64_t)(uintptr_t)o;
+    return result;
+}
+#else
+inline TachyonVal::Tag TachyonVal::tag() const {
+    return t;
+}
+
+inline double TachyonVal::n() const {
+    return num;
+}
+
+inline bool TachyonVal::b() const {
+    return boolean;
+}
+
+inline char TachyonVal::c() const {
+    return chr;
+}
+
+inline TachyonObject* TachyonVal::o() const {
+    return obj;
+}
+
+inline TachyonVal TachyonVal::make_nil() {
+    TachyonVal result;
+    result.t = NIL;
+    return result;
+}
+
+inline TachyonVal TachyonVal::make_num(double n) {
+    TachyonVal result;
+    result.t = NUM;
+    result.num = n;
+    return result;
+}
+
+inline TachyonVal TachyonVal::make_bool(bool b) {
+    TachyonVal result;
+    result.t = BOOL;
+    result.boolean = b;
+    return result;
+}
+
+inline TachyonVal TachyonVal::make_char(char c) {
+    TachyonVal result;
+    result.t = CHAR;
+    result.chr = c;
+    return result;
+}
+
+inline TachyonVal TachyonVal::make_ptr(TachyonObject* o) {
+    TachyonVal result;
+    result.t = OBJECT;
+    result.obj = o;
+    return result;
+}
+#endif
+
+inline TachyonVal TachyonVal::operator+() const {
+    assert(tag() == NUM);
+    return TachyonVal::make_num(+n());
+}
+
+inline TachyonVal TachyonVal::operator-() const {
+    assert(tag() == NUM);
+    return TachyonVal::make_num(-n());
+}
+
+inline TachyonVal TachyonVal::operator+(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num(n() + other.n());
+}
+
+inline TachyonVal TachyonVal::operator-(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num(n() - other.n());
+}
+
+inline TachyonVal TachyonVal::operator*(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num(n() * other.n());
+}
+
+inline TachyonVal TachyonVal::operator/(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num(n() / other.n());
+}
+
+inline TachyonVal TachyonVal::operator%(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num(std::fmod(n(), other.n()));
+}
+
+inline TachyonVal TachyonVal::operator<<(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num((int64_t)n() << (int64_t)other.n());
+}
+
+inline TachyonVal TachyonVal::operator>>(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num((int64_t)n() >> (int64_t)other.n());
+}
+
+inline TachyonVal TachyonVal::operator&(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num((int64_t)n() & (int64_t)other.n());
+}
+
+inline TachyonVal TachyonVal::operator|(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num((int64_t)n() | (int64_t)other.n());
+}
+
+inline TachyonVal TachyonVal::operator^(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_num((int64_t)n() ^ (int64_t)other.n());
+}
+
+inline TachyonVal TachyonVal::operator&&(const TachyonVal& other) const {
+    assert(tag() == BOOL && other.tag() == BOOL);
+    return TachyonVal::make_bool(b() && other.b());
+}
+
+inline TachyonVal TachyonVal::operator||(const TachyonVal& other) const {
+    assert(tag() == BOOL && other.tag() == BOOL);
+    return TachyonVal::make_bool(b() || other.b());
+}
+
+inline TachyonVal TachyonVal::operator<(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_bool(n() < other.n());
+}
+
+inline TachyonVal TachyonVal::operator<=(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_bool(n() <= other.n());
+}
+
+inline TachyonVal TachyonVal::operator>(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_bool(n() > other.n());
+}
+
+inline TachyonVal TachyonVal::operator>=(const TachyonVal& other) const {
+    assert(tag() == NUM && other.tag() == NUM);
+    return TachyonVal::make_bool(n() >= other.n());
+}
+
+inline TachyonVal TachyonVal::operator==(const TachyonVal& other) const {
+    if (tag() == NIL) {
+        return TachyonVal::make_bool(other.tag() == NIL);
+    }
+    else if (tag() == NUM) {
+        return TachyonVal::make_bool(other.tag() == NUM && n() == other.n());
+    }
+    else if (tag() == BOOL) {
+        return TachyonVal::make_bool(other.tag() == BOOL && b() == other.b());
+    }
+    else if (tag() == OBJECT) {
+        return TachyonVal::make_bool(other.tag() == OBJECT && o() == other.o());
+    }
+    return TachyonVal::make_nil();
+}
+
+inline TachyonVal TachyonVal::operator!=(const TachyonVal& other) const {
+    return TachyonVal::make_bool(!(operator==(other)).b());
+}
+
+inline TachyonVal TachyonVal::operator()(TachyonArgs args) {
+    assert(tag() == OBJECT);
+    args.func = static_cast<TachyonFunc*>(o());
+    return args.func->f(args);
+}
+
+inline TachyonArgs::TachyonArgs()
+    : vals(nullptr), count(0), func(nullptr) {
+}
+
+// The list's backing array lives until the end of the full-expression containing the call
+inline TachyonArgs::TachyonArgs(std::initializer_list<TachyonVal> list) {
+    vals = list.begin();
+    count = list.size();
+    func = nullptr;
+}
+
+inline TachyonArgs::TachyonArgs(const TachyonVal* vals, std::size_t count)
+    : vals(vals), count(count), func(nullptr) {
+}
+
+inline std::size_t TachyonArgs::size() const {
+    return count;
+}
+
+inline const TachyonVal& TachyonArgs::at(std::size_t i) const {
+    if (i >= count) {
+        throw std::out_of_range("argument " + std::to_string(i) + " out of range");
+    }
+    return vals[i];
+}
+
+// Unboxes an operand of an unboxed operator, checking its tag like the boxed operators do
+inline double tachyon_num(const TachyonVal& val) {
+    assert(val.tag() == TachyonVal::NUM);
+    return val.n();
+}
+
+inline bool tachyon_bool(const TachyonVal& val) {
+    assert(val.tag() == TachyonVal::BOOL);
+    return val.b();
+}
+
+inline std::size_t TachyonSlots::size() const {
+    return count;
+}
+
+inline TachyonVal& TachyonSlots::operator[](std::size_t i) {
+    return vals[i];
+}
+
+inline const TachyonVal& TachyonSlots::operator[](std::size_t i) const {
+    return vals[i];
+}
+
+inline TachyonVal* TachyonSlots::begin() {
+    return vals;
+}
+
+inline TachyonVal* TachyonSlots::end() {
+    return vals + count;
+}
+
+// Values are copied a word at a time with atomic loads and stores, so a read racing a write may
+// see a torn value but never a data race. Seqlock readers throw torn values away.
+inline TachyonVal TachyonSlots::load(std::size_t i) const {
+    static_assert(sizeof(TachyonVal) % sizeof(uint64_t) == 0, "values are copied in words");
+    const uint64_t* from = reinterpret_cast<const uint64_t*>(__atomic_load_n(&vals, __ATOMIC_ACQUIRE) + i);
+    uint64_t words[sizeof(TachyonVal) / sizeof(uint64_t)];
+    for (std::size_t w = 0; w < sizeof(words) / sizeof(uint64_t); w++) {
+        words[w] = __atomic_load_n(from + w, __ATOMIC_RELAXED);
+    }
+    TachyonVal val;
+    std::memcpy(&val, words, sizeof(TachyonVal));
+    return val;
+}
+
+inline void TachyonSlots::store(std::size_t i, const TachyonVal& val) {
+    uint64_t words[sizeof(TachyonVal) / sizeof(uint64_t)];
+    std::memcpy(words, &val, sizeof(TachyonVal));
+    uint64_t* to = reinterpret_cast<uint64_t*>(vals + i);
+    for (std::size_t w = 0; w < sizeof(words) / sizeof(uint64_t); w++) {
+        __atomic_store_n(to + w, words[w], __ATOMIC_RELAXED);
+    }
+}
+
+inline TachyonShape* TachyonObject::load_shape() const {
+    return __atomic_load_n(&shape, __ATOMIC_ACQUIRE);
+}
+
+inline unsigned TachyonObject::read_begin() const {
+    unsigned start = seq.load(std::memory_order_acquire);
+    return (start & 1) ? read_wait() : start;
+}
+
+inline bool TachyonObject::read_end(unsigned start) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq.load(std::memory_order_relaxed) == start;
+}
+
+inline TachyonVal TachyonCache::get(const TachyonObject* obj, const char* key) {
+    if (__builtin_expect(tachyon_threaded.load(std::memory_order_relaxed), false)) {
+        return get_shared(obj, key);
+    }
+    if (obj->shape == shapes[0]) {
+        const TachyonObject* holder = obj;
+        std::size_t i = 1;
+        for (; i <= depth; i++) {
+            holder = holder->slots[holder->shape->proto_slot].o();
+            if (holder->shape != shapes[i]) {
+                break;
+            }
+        }
+        if (i > depth) {
+            return holder->slots[slot];
+        }
+    }
+    return update(obj, key);
+}
+
+// Calls the method key of the receiver in args[0]. The receiver is only evaluated once, when the
+// arguments are, and the method is looked up after them.
+inline TachyonVal TachyonCache::call(const char* key, TachyonArgs args) {
+    return get(args.vals[0].o(), key)(args);
+}
+
+inline TachyonVal TachyonHoist::get(TachyonCache& cache, const TachyonObject* obj, const char* key) {
+    if (obj == this->obj && epoch == tachyon_epoch.load(std::memory_order_relaxed)) {
+        return val;
+    }
+    return reload(cache, obj, key);
+}
+
+inline TachyonVal TachyonHoist::call(TachyonCache& cache, const char* key, TachyonArgs args) {
+    return get(cache, args.vals[0].o(), key)(args);
+}
+
+inline void TachyonHeap::safepoint() {
+    if (requested.load(std::memory_order_relaxed)) {
+        park();
+    }
+}
+
+#endif // TACHYON_H
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#include <direct.h>
+#include <process.h>
+#include <io.h>
+#include <sys/utime.h>
+#define getpid _getpid
+#define utime _utime
+#else
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#endif
+#include "cache.h"
+
+namespace tachyon {
+    static const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    static uint32_t rotr(uint32_t x, int n) {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    // SHA-256 as specified in FIPS 180-4, returned as lowercase hex
+    std::string sha256(const std::string& data) {
+        uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        std::string msg = data;
+        uint64_t bits = (uint64_t)data.size() * 8;
+        msg += (char)0x80;
+        while (msg.size() % 64 != 56) {
+            msg += (char)0;
+        }
+        for (int i = 7; i >= 0; i--) {
+            msg += (char)(bits >> (i * 8));
+        }
+        for (std::size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; i++) {
+                const unsigned char* p = (const unsigned char*)msg.data() + chunk + i * 4;
+                w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+            }
+            for (int i = 16; i < 64; i++) {
+                uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+            for (int i = 0; i < 64; i++) {
+                uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+                uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                hh = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+            h[5] += f;
+            h[6] += g;
+            h[7] += hh;
+        }
+        static const char* digits = "0123456789abcdef";
+        std::string hex;
+        for (int i = 0; i < 8; i++) {
+            for (int j = 28; j >= 0; j -= 4) {
+                hex += digits[(h[i] >> j) & 0xf];
+            }
+        }
+        return hex;
+    }
+
+    static bool copy_file(const std::string& from, const std::string& to) {
+        std::ifstream in(from, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        std::ofstream out(to, std::ios::binary | std::ios::trunc);
+        out << in.rdbuf();
+        out.close();
+        return !out.fail();
+    }
+
+    // Creates dir and any missing parents
+    static void make_dirs(const std::string& dir) {
+        for (std::size_t i = 1; i <= dir.size(); i++) {
+            if (i == dir.size() || dir[i] == '/' || dir[i] == '\\') {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+                _mkdir(dir.substr(0, i).c_str());
+#else
+                mkdir(dir.substr(0, i).c_str(), 0755);
+#endif
+            }
+        }
+    }
+
+    Cache::Cache(const std::string& dir, std::uintmax_t limit)
+        : dir(dir), limit(limit) {
+    }
+
+    // TACHYON_CACHE_DIR, or the user's cache directory. Empty if neither can be found.
+    std::string Cache::default_dir() {
+        if (const char* dir = std::getenv("TACHYON_CACHE_DIR")) {
+            return dir;
+        }
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+        if (const char* local = std::getenv("LOCALAPPDATA")) {
+            return std::string(local) + "\\tachyon";
+        }
+#else
+        if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+            return std::string(xdg) + "/tachyon";
+        }
+        if (const char* home = std::getenv("HOME")) {
+            return std::string(home) + "/.cache/tachyon";
+        }
+#endif
+        return "";
+    }
+
+    // TACHYON_CACHE_SIZE megabytes, or 1 GB. 0 turns eviction off.
+    std::uintmax_t Cache::default_limit() {
+        if (const char* size = std::getenv("TACHYON_CACHE_SIZE")) {
+            return std::strtoull(size, nullptr, 10) * 1024 * 1024;
+        }
+        return (std::uintmax_t)1024 * 1024 * 1024;
+    }
+
+    std::string Cache::path(const std::string& key) const {
+        return dir + "/" + key;
+    }
+
+    // Where an entry is written before it is renamed into place, unique to the process and the
+    // call, since files parsed on different threads can store the same entry
+    std::string Cache::temp_path(const std::string& key) const {
+        static std::atomic<unsigned> count(0);
+        return path(key) + ".tmp" + std::to_string(getpid()) + "." + std::to_string(count++);
+    }
+
+    // Every entry in the directory, leaving out those that other builds are still writing
+    std::vector<Cache::Entry> Cache::entries() const {
+        std::vector<Entry> list;
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+        _finddatai64_t data;
+        intptr_t handle = _findfirsti64((dir + "\\*").c_str(), &data);
+        if (handle == -1) {
+            return list;
+        }
+        do {
+            std::string name = data.name;
+            if (!(data.attrib & _A_SUBDIR) && name.find(".tmp") == std::string::npos) {
+                list.push_back({path(name), (long long)data.time_write, (std::uintmax_t)data.size});
+            }
+        } while (_findnexti64(handle, &data) == 0);
+        _findclose(handle);
+#else
+        DIR* handle = opendir(dir.c_str());
+        if (!handle) {
+            return list;
+        }
+        while (dirent* item = readdir(handle)) {
+            std::string name = item->d_name;
+            struct stat info;
+            if (name.find(".tmp") == std::string::npos && stat(path(name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                list.push_back({path(name), (long long)info.st_mtime, (std::uintmax_t)info.st_size});
+            }
+        }
+        closedir(handle);
+#endif
+        return list;
+    }
+
+    // Marks an entry as just used, since eviction goes by modification time
+    void Cache::touch(const std::string& key) const {
+        utime(path(key).c_str(), nullptr);
+    }
+
+    // Removes the least recently used entries until the rest fit in the limit. Called once per
+    // build rather than on every store, since it reads the whole directory.
+    void Cache::trim() const {
+        if (dir.empty() || !limit) {
+            return;
+        }
+        std::vector<Entry> list = entries();
+        std::uintmax_t total = 0;
+        for (const Entry& entry : list) {
+            total += entry.size;
+        }
+        std::sort(list.begin(), list.end(), [](const Entry& a, const Entry& b) {
+            return a.time < b.time;
+        });
+        for (std::size_t i = 0; i < list.size() && total > limit; i++) {
+            std::remove(list[i].path.c_str());
+            total -= list[i].size;
+        }
+    }
+
+    void Cache::clear() const {
+        for (const Entry& entry : entries()) {
+            std::remove(entry.path.c_str());
+        }
+    }
+
+    // Copies the binary stored under key to out, if there is one
+    bool Cache::fetch(const std::string& key, const std::string& out) const {
+        if (!copy_file(path(key), out)) {
+            return false;
+        }
+        touch(key);
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__))
+        chmod(out.c_str(), 0755);
+#endif
+        return true;
+    }
+
+    // Entries are written under a temporary name and renamed into place, so a concurrent fetch
+    // never sees half a binary. If the rename fails because another build stored the same key
+    // first, that entry is identical anyway.
+    void Cache::store(const std::string& key, const std::string& file) const {
+        make_dirs(dir);
+        std::string tmp = temp_path(key);
+        if (!copy_file(file, tmp) || std::rename(tmp.c_str(), path(key).c_str()) != 0) {
+            std::remove(tmp.c_str());
+        }
+    }
+
+    // Reads an entry that holds data rather than a binary
+    bool Cache::read(const std::string& key, std::string& data) const {
+        std::ifstream in(path(key), std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (in.bad()) {
+            return false;
+        }
+        touch(key);
+        return true;
+    }
+
+    // Written and renamed into place like store
+    void Cache::write(const std::string& key, const std::string& data) const {
+        make_dirs(dir);
+        std::string tmp = temp_path(key);
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << data;
+        out.close();
+        if (out.fail() || std::rename(tmp.c_str(), path(key).c_str()) != 0) {
+            std::remove(tmp.c_str());
+        }
+    }
+} // namespace tachyon
\ No newline at end of file
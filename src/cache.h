@@ -0,0 +1,39 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <string>
+#include <cstdint>
+#include <vector>
+
+namespace tachyon {
+    std::string sha256(const std::string& data);
+
+    // On-disk store of compiled binaries and parsed files, each named by the hash of everything that went into it.
+    // Entries are evicted least recently used first once they take up more than limit bytes.
+    class Cache {
+    private:
+        struct Entry {
+            std::string path;
+            long long time;
+            std::uintmax_t size;
+        };
+        std::string dir{};
+        std::uintmax_t limit{};
+        std::string path(const std::string& key) const;
+        std::string temp_path(const std::string& key) const;
+        std::vector<Entry> entries() const;
+        void touch(const std::string& key) const;
+    public:
+        Cache(const std::string& dir, std::uintmax_t limit = default_limit());
+        static std::string default_dir();
+        static std::uintmax_t default_limit();
+        void trim() const;
+        void clear() const;
+        bool fetch(const std::string& key, const std::string& out) const;
+        void store(const std::string& key, const std::string& file) const;
+        bool read(const std::string& key, std::string& data) const;
+        void write(const std::string& key, const std::string& data) const;
+    };
+} // namespace tachyon
+
+#endif // CACHE_H
\ No newline at end of file
@@ -0,0 +1,460 @@
+#include <string>
+#include <memory>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include "node.h"
+#include "inferrer.h"
+#include "module.h"
+
+namespace tachyon {
+    Binding::Binding(const std::string& name, int depth, bool fixed, Env* env)
+        : name(name), depth(depth), fixed(fixed), captured(false), mutated(false), initialized(true), type(ValueType::UNKNOWN),
+          func(nullptr), env(env), slot(-1) {
+    }
+
+    Function::Function(FuncDeclStmtNode* node, Binding* binding)
+        : node(node), binding(binding), falls_through(true), type(ValueType::UNKNOWN) {
+        StmtListNode* stmt_list_node = static_cast<StmtListNode*>(static_cast<BlockStmtNode*>(node->body)->node);
+        if (!stmt_list_node->stmts.empty() && stmt_list_node->stmts.back()->kind() == NodeKind::RETURN_STMT) {
+            falls_through = false;
+        }
+    }
+
+    Closure::Closure(Node* node)
+        : node(node) {
+    }
+
+    // UNKNOWN means no assignment has been typed yet, so it gives way to any other type
+    static ValueType join(ValueType a, ValueType b) {
+        if (a == ValueType::UNKNOWN) {
+            return b;
+        }
+        if (b == ValueType::UNKNOWN || a == b) {
+            return a;
+        }
+        return ValueType::DYNAMIC;
+    }
+
+    Inferrer::Inferrer(const std::string& filename)
+        : filename(filename) {
+    }
+
+    void Inferrer::push_scope(Env* env) {
+        scopes.push_back({});
+        envs.push_back(env);
+    }
+
+    void Inferrer::pop_scope() {
+        scopes.pop_back();
+        envs.pop_back();
+    }
+
+    Binding* Inferrer::declare(const std::string& name, bool fixed) {
+        bindings.push_back(std::shared_ptr<Binding>(new Binding(name, depth, fixed, envs.back())));
+        scopes.back()[name] = bindings.back().get();
+        return bindings.back().get();
+    }
+
+    Binding* Inferrer::lookup(const std::string& name) {
+        for (std::size_t i = scopes.size(); i-- > 0;) {
+            std::map<std::string, Binding*>::iterator it = scopes.at(i).find(name);
+            if (it != scopes.at(i).end()) {
+                if (it->second->depth != depth) {
+                    it->second->captured = true;
+                    // A closure in the variable's own initializer can't copy it yet, so it must share it
+                    if (!it->second->initialized) {
+                        it->second->mutated = true;
+                    }
+                    for (int d = it->second->depth; d < depth; d++) {
+                        if (frames.at(d)) {
+                            frames.at(d)->free.insert(it->second);
+                        }
+                        std::vector<Binding*>& free = closure_frames.at(d)->free;
+                        if (std::find(free.begin(), free.end(), it->second) == free.end()) {
+                            free.push_back(it->second);
+                        }
+                    }
+                }
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    // Maps identifiers to the variables they refer to, following the block structure of the generated C++
+    void Inferrer::resolve(Node* node) {
+        switch (node->kind()) {
+        case NodeKind::IDENTIFIER: {
+            if (Binding* binding = lookup(static_cast<IdentifierNode*>(node)->val)) {
+                refs[node] = binding;
+                if (binding->func) {
+                    binding->func->node->escapes = true;
+                }
+            }
+            break;
+        }
+        case NodeKind::CALL_EXPR: {
+            CallExprNode* call_expr_node = static_cast<CallExprNode*>(node);
+            Node* callee = call_expr_node->callee;
+            Binding* binding = nullptr;
+            if (callee->kind() == NodeKind::IDENTIFIER) {
+                binding = lookup(static_cast<IdentifierNode*>(callee)->val);
+            }
+            if (binding && binding->func && binding->func->node->args.size() == call_expr_node->args.size()) {
+                refs[callee] = binding;
+                binding->func->calls.push_back(call_expr_node);
+            }
+            else {
+                resolve(callee);
+            }
+            for (Node* arg : call_expr_node->args) {
+                resolve(arg);
+            }
+            break;
+        }
+        case NodeKind::LAMBDA_EXPR: {
+            LambdaExprNode* lambda_expr_node = static_cast<LambdaExprNode*>(node);
+            resolve_function(node, lambda_expr_node->args, lambda_expr_node->body, &lambda_expr_node->env, nullptr);
+            break;
+        }
+        case NodeKind::RETURN_STMT:
+            if (!frames.empty() && frames.back()) {
+                frames.back()->returns.push_back(static_cast<ReturnStmtNode*>(node)->node);
+            }
+            resolve(static_cast<ReturnStmtNode*>(node)->node);
+            break;
+        case NodeKind::BINARY_EXPR: {
+            BinaryExprNode* binary_expr_node = static_cast<BinaryExprNode*>(node);
+            resolve(binary_expr_node->node_a);
+            resolve(binary_expr_node->node_b);
+            if (binary_expr_node->op.val == "=" && refs.count(binary_expr_node->node_a)) {
+                refs[binary_expr_node->node_a]->vals.push_back(binary_expr_node->node_b);
+                refs[binary_expr_node->node_a]->mutated = true;
+            }
+            break;
+        }
+        case NodeKind::VAR_DECL_STMT: {
+            // As in C++, the variable is in scope in its own initializer
+            VarDeclStmtNode* var_decl_stmt_node = static_cast<VarDeclStmtNode*>(node);
+            Binding* binding = declare(var_decl_stmt_node->name, false);
+            binding->initialized = false;
+            resolve(var_decl_stmt_node->val);
+            binding->initialized = true;
+            binding->vals.push_back(var_decl_stmt_node->val);
+            refs[node] = binding;
+            break;
+        }
+        case NodeKind::BLOCK_STMT:
+            push_scope(&static_cast<BlockStmtNode*>(node)->env);
+            resolve(static_cast<BlockStmtNode*>(node)->node);
+            pop_scope();
+            break;
+        case NodeKind::FOR_STMT:
+            push_scope(&static_cast<ForStmtNode*>(node)->env);
+            for (Node* child : children(node)) {
+                resolve(child);
+            }
+            pop_scope();
+            break;
+        case NodeKind::FUNC_DECL_STMT: {
+            FuncDeclStmtNode* func_decl_stmt_node = static_cast<FuncDeclStmtNode*>(node);
+            Binding* binding = declare(func_decl_stmt_node->name, true);
+            functions.push_back(std::shared_ptr<Function>(new Function(func_decl_stmt_node, binding)));
+            binding->func = functions.back().get();
+            resolve_function(node, func_decl_stmt_node->args, func_decl_stmt_node->body, &func_decl_stmt_node->env, binding->func);
+            break;
+        }
+        case NodeKind::IMPORT_STMT: {
+            // The module's variables already have slots in its TachyonEnv
+            ImportStmtNode* import_stmt_node = static_cast<ImportStmtNode*>(node);
+            import_stmt_node->env.id = env_count++;
+            import_stmt_node->env.vars = import_stmt_node->module->exports;
+            for (std::size_t i = 0; i < import_stmt_node->env.vars.size(); i++) {
+                Binding* binding = declare(import_stmt_node->env.vars.at(i), true);
+                binding->env = &import_stmt_node->env;
+                binding->slot = i;
+            }
+            break;
+        }
+        case NodeKind::TRY_CATCH_STMT: {
+            TryCatchStmtNode* try_catch_stmt_node = static_cast<TryCatchStmtNode*>(node);
+            resolve(try_catch_stmt_node->try_body);
+            push_scope(&try_catch_stmt_node->env);
+            declare(try_catch_stmt_node->ex, true);
+            resolve(try_catch_stmt_node->catch_body);
+            pop_scope();
+            break;
+        }
+        default:
+            for (Node* child : children(node)) {
+                resolve(child);
+            }
+        }
+    }
+
+    void Inferrer::resolve_function(Node* node, const std::vector<std::string>& args, Node* body, Env* env, Function* func) {
+        depth++;
+        closures.push_back(std::shared_ptr<Closure>(new Closure(node)));
+        frames.push_back(func);
+        closure_frames.push_back(closures.back().get());
+        push_scope(env);
+        for (const std::string& arg : args) {
+            Binding* param = declare(arg, true);
+            if (func) {
+                func->params.push_back(param);
+            }
+        }
+        resolve(body);
+        pop_scope();
+        frames.pop_back();
+        closure_frames.pop_back();
+        depth--;
+    }
+
+    void Inferrer::find_direct() {
+        for (const std::shared_ptr<Function>& func : functions) {
+            func->node->direct = func->binding->vals.empty();
+            for (Binding* binding : func->free) {
+                if (!binding->func) {
+                    func->node->direct = false;
+                }
+            }
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (const std::shared_ptr<Function>& func : functions) {
+                if (!func->node->direct) {
+                    continue;
+                }
+                for (Binding* binding : func->free) {
+                    if (!binding->func->node->direct) {
+                        func->node->direct = false;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+        // Parameters of a def that is only ever called directly get the types of its arguments
+        for (const std::shared_ptr<Function>& func : functions) {
+            if (!func->node->direct || func->node->escapes) {
+                continue;
+            }
+            for (std::size_t i = 0; i < func->params.size(); i++) {
+                func->params.at(i)->fixed = false;
+                for (CallExprNode* call : func->calls) {
+                    func->params.at(i)->vals.push_back(call->args.at(i));
+                }
+            }
+        }
+    }
+
+    // Captured variables that are reassigned get a slot in the Env of the scope that declares them,
+    // so the scope and its closures share one copy however long each of them lives
+    void Inferrer::convert_closures() {
+        for (const std::shared_ptr<Binding>& binding : bindings) {
+            if (!binding->captured || !binding->mutated || !binding->env || binding->slot != -1) {
+                continue;
+            }
+            if (binding->env->id == -1) {
+                binding->env->id = env_count++;
+            }
+            binding->slot = binding->env->vars.size();
+            binding->env->vars.push_back(binding->name);
+        }
+    }
+
+    bool Inferrer::is_direct_call(Node* node) const {
+        if (node->kind() != NodeKind::CALL_EXPR) {
+            return false;
+        }
+        std::unordered_map<Node*, Binding*>::const_iterator it = refs.find(static_cast<CallExprNode*>(node)->callee);
+        return it != refs.end() && it->second->func && it->second->func->node->direct
+            && it->second->func->node->args.size() == static_cast<CallExprNode*>(node)->args.size();
+    }
+
+    // Type of the value an expression produces, given the current types of the variables.
+    // Arithmetic and comparisons always produce numbers and bools since their boxed versions
+    // assert on the tags of their operands.
+    ValueType Inferrer::type_of(Node* node) const {
+        switch (node->kind()) {
+        case NodeKind::NUMBER:
+            return ValueType::NUMBER;
+        case NodeKind::TRUE:
+        case NodeKind::FALSE:
+            return ValueType::BOOL;
+        case NodeKind::IDENTIFIER: {
+            std::unordered_map<Node*, Binding*>::const_iterator it = refs.find(node);
+            return it == refs.end() ? ValueType::DYNAMIC : it->second->type;
+        }
+        case NodeKind::PAREN_EXPR:
+            return type_of(static_cast<ParenExprNode*>(node)->node);
+        case NodeKind::UNARY_EXPR:
+            return ValueType::NUMBER;
+        case NodeKind::CALL_EXPR:
+            if (is_direct_call(node)) {
+                return refs.at(static_cast<CallExprNode*>(node)->callee)->func->type;
+            }
+            return ValueType::DYNAMIC;
+        case NodeKind::BINARY_EXPR: {
+            BinaryExprNode* binary_expr_node = static_cast<BinaryExprNode*>(node);
+            std::string op = binary_expr_node->op.val;
+            if (op == "=") {
+                std::unordered_map<Node*, Binding*>::const_iterator it = refs.find(binary_expr_node->node_a);
+                return it == refs.end() ? ValueType::DYNAMIC : it->second->type;
+            }
+            else if (op == "==" || op == "!=" || op == "^^") {
+                ValueType a = type_of(binary_expr_node->node_a);
+                ValueType b = type_of(binary_expr_node->node_b);
+                if (a == ValueType::UNKNOWN || b == ValueType::UNKNOWN) {
+                    return ValueType::UNKNOWN;
+                }
+                return (a == b && a != ValueType::DYNAMIC) ? ValueType::BOOL : ValueType::DYNAMIC;
+            }
+            else if (op == "<" || op == "<=" || op == ">" || op == ">=" || op == "&&" || op == "||") {
+                return ValueType::BOOL;
+            }
+            return ValueType::NUMBER;
+        }
+        default:
+            return ValueType::DYNAMIC;
+        }
+    }
+
+    void Inferrer::annotate(Node* node) {
+        for (Node* child : children(node)) {
+            annotate(child);
+        }
+        if (node->kind() == NodeKind::IDENTIFIER) {
+            std::unordered_map<Node*, Binding*>::const_iterator it = refs.find(node);
+            if (it != refs.end() && it->second->func && it->second->func->node->direct) {
+                static_cast<IdentifierNode*>(node)->func = it->second->func->node;
+            }
+            if (it != refs.end() && it->second->slot != -1) {
+                static_cast<IdentifierNode*>(node)->env = it->second->env->id;
+                static_cast<IdentifierNode*>(node)->slot = it->second->slot;
+            }
+        }
+        if (node->kind() == NodeKind::VAR_DECL_STMT) {
+            node->type = refs.at(node)->type;
+        }
+        else if (node->kind() == NodeKind::FUNC_DECL_STMT) {
+            node->type = ValueType::DYNAMIC;
+        }
+        else {
+            node->type = type_of(node);
+        }
+    }
+
+    void Inferrer::infer(Node* node, Module* module) {
+        Env* root = node->kind() == NodeKind::STMT_LIST ? &static_cast<StmtListNode*>(node)->env : nullptr;
+        push_scope(root);
+        resolve(node);
+        pop_scope();
+        if (module && root) {
+            // Everything a module declares at the top level is exported through its TachyonEnv
+            root->id = env_count++;
+            for (const std::shared_ptr<Binding>& binding : bindings) {
+                if (binding->env == root && binding->depth == 0 && binding->slot == -1) {
+                    binding->captured = true;
+                    binding->mutated = true;
+                    if (binding->func) {
+                        binding->func->node->escapes = true;
+                    }
+                }
+            }
+        }
+        find_direct();
+        convert_closures();
+        if (module && root) {
+            module->exports = root->vars;
+        }
+        // Variables copied into closures can still be raw, they are boxed only for the copy
+        for (const std::shared_ptr<Binding>& binding : bindings) {
+            binding->type = (binding->fixed || binding->slot != -1) ? ValueType::DYNAMIC : ValueType::UNKNOWN;
+        }
+        for (const std::shared_ptr<Function>& func : functions) {
+            func->type = (func->node->direct && !func->falls_through) ? ValueType::UNKNOWN : ValueType::DYNAMIC;
+        }
+        // Types only move from UNKNOWN to NUMBER or BOOL and then to DYNAMIC, so this terminates
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (const std::shared_ptr<Binding>& binding : bindings) {
+                if (binding->type == ValueType::DYNAMIC) {
+                    continue;
+                }
+                ValueType type = ValueType::UNKNOWN;
+                for (Node* val : binding->vals) {
+                    type = join(type, type_of(val));
+                }
+                if (type != binding->type) {
+                    binding->type = type;
+                    changed = true;
+                }
+            }
+            for (const std::shared_ptr<Function>& func : functions) {
+                if (func->type == ValueType::DYNAMIC) {
+                    continue;
+                }
+                ValueType type = ValueType::UNKNOWN;
+                for (Node* val : func->returns) {
+                    type = join(type, type_of(val));
+                }
+                if (type != func->type) {
+                    func->type = type;
+                    changed = true;
+                }
+            }
+            if (!changed) {
+                // Variables that only depend on each other have no type to start from
+                for (const std::shared_ptr<Binding>& binding : bindings) {
+                    if (binding->type == ValueType::UNKNOWN) {
+                        binding->type = ValueType::DYNAMIC;
+                        changed = true;
+                    }
+                }
+                for (const std::shared_ptr<Function>& func : functions) {
+                    if (func->type == ValueType::UNKNOWN) {
+                        func->type = ValueType::DYNAMIC;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        annotate(node);
+        for (const std::shared_ptr<Function>& func : functions) {
+            func->node->type = func->type;
+            for (Binding* param : func->params) {
+                func->node->arg_types.push_back(param->type);
+            }
+        }
+        for (const std::shared_ptr<Closure>& closure : closures) {
+            std::vector<Capture>* captures;
+            if (closure->node->kind() == NodeKind::LAMBDA_EXPR) {
+                captures = &static_cast<LambdaExprNode*>(closure->node)->captures;
+            }
+            else if (!static_cast<FuncDeclStmtNode*>(closure->node)->direct) {
+                captures = &static_cast<FuncDeclStmtNode*>(closure->node)->captures;
+            }
+            else {
+                continue;
+            }
+            for (Binding* binding : closure->free) {
+                if (binding->func && binding->func->node->direct) {
+                    // Called or wrapped by name
+                    continue;
+                }
+                if (binding->func && binding->func->node == closure->node && binding->slot == -1) {
+                    static_cast<FuncDeclStmtNode*>(closure->node)->recursive = true;
+                    continue;
+                }
+                captures->push_back(Capture(binding->name, binding->type, binding->slot == -1 ? -1 : binding->env->id, binding->slot));
+            }
+        }
+    }
+} // namespace tachyon
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef INFERRER_H
+#define INFERRER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include "node.h"
+
+namespace tachyon {
+    class Function;
+    class Module;
+
+    // A variable introduced by var, def, a parameter or a catch clause
+    class Binding {
+    public:
+        std::string name;
+        std::vector<Node*> vals{};
+        int depth;
+        bool fixed;
+        bool captured;
+        bool mutated;
+        bool initialized;
+        ValueType type;
+        Function* func;
+        Env* env;
+        int slot;
+        Binding(const std::string& name, int depth, bool fixed, Env* env);
+    };
+
+    // A def, which becomes a plain C++ function if everything it refers to outside itself is
+    // global or another such def and its name is never reassigned
+    class Function {
+    public:
+        FuncDeclStmtNode* node;
+        Binding* binding;
+        std::vector<Binding*> params{};
+        std::vector<CallExprNode*> calls{};
+        std::vector<Node*> returns{};
+        std::set<Binding*> free{};
+        bool falls_through;
+        ValueType type;
+        Function(FuncDeclStmtNode* node, Binding* binding);
+    };
+
+    // A lambda or def, with the variables of enclosing functions it refers to in order of first use
+    class Closure {
+    public:
+        Node* node;
+        std::vector<Binding*> free{};
+        Closure(Node* node);
+    };
+
+    // Proves which variables only ever hold numbers or only ever hold bools, so the transpiler can
+    // store them as raw C++ doubles and bools. Captured variables that are reassigned stay boxed and
+    // are moved into heap environments, so closures never refer to the stack frames they came from.
+    class Inferrer {
+    private:
+        std::string filename{};
+        std::vector<std::shared_ptr<Binding> > bindings{};
+        std::vector<std::shared_ptr<Function> > functions{};
+        std::vector<std::shared_ptr<Closure> > closures{};
+        std::vector<Function*> frames{};
+        std::vector<Closure*> closure_frames{};
+        std::vector<std::map<std::string, Binding*> > scopes{};
+        std::vector<Env*> envs{};
+        std::unordered_map<Node*, Binding*> refs{};
+        int depth{};
+        int env_count{};
+        void push_scope(Env* env);
+        void pop_scope();
+        Binding* declare(const std::string& name, bool fixed);
+        Binding* lookup(const std::string& name);
+        void resolve(Node* node);
+        void resolve_function(Node* node, const std::vector<std::string>& args, Node* body, Env* env, Function* func);
+        void find_direct();
+        void convert_closures();
+        bool is_direct_call(Node* node) const;
+        ValueType type_of(Node* node) const;
+        void annotate(Node* node);
+    public:
+        Inferrer(const std::string& filename);
+        void infer(Node* node, Module* module = nullptr);
+    };
+} // namespace tachyon
+
+#endif // INFERRER_H
\ No newline at end of file
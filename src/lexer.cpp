@@ -1,46 +1,110 @@
 #include <string>
 #include <vector>
-#include <map>
+#include <cstring>
+#include <cctype>
 #include "token.h"
 #include "lexer.h"
 
 namespace tachyon {
+    struct Keyword {
+        const char* name;
+        TokenType type;
+    };
+
+    // Indexed by (first + 3 * last + 4 * length) & 31, which is different for every keyword
+    static const Keyword KEYWORDS[32] = {
+        {nullptr, TokenType::IDENTIFIER},
+        {nullptr, TokenType::IDENTIFIER},
+        {"def", TokenType::DEF},
+        {"if", TokenType::IF},
+        {"else", TokenType::ELSE},
+        {nullptr, TokenType::IDENTIFIER},
+        {nullptr, TokenType::IDENTIFIER},
+        {"lambda", TokenType::LAMBDA},
+        {"for", TokenType::FOR},
+        {"false", TokenType::FALSE},
+        {nullptr, TokenType::IDENTIFIER},
+        {"try", TokenType::TRY},
+        {nullptr, TokenType::IDENTIFIER},
+        {nullptr, TokenType::IDENTIFIER},
+        {nullptr, TokenType::IDENTIFIER},
+        {"catch", TokenType::CATCH},
+        {nullptr, TokenType::IDENTIFIER},
+        {nullptr, TokenType::IDENTIFIER},
+        {nullptr, TokenType::IDENTIFIER},
+        {"true", TokenType::TRUE},
+        {"return", TokenType::RETURN},
+        {nullptr, TokenType::IDENTIFIER},
+        {nullptr, TokenType::IDENTIFIER},
+        {"block", TokenType::BLOCK},
+        {"var", TokenType::VAR},
+        {nullptr, TokenType::IDENTIFIER},
+        {"while", TokenType::WHILE},
+        {"cimport", TokenType::CIMPORT},
+        {nullptr, TokenType::IDENTIFIER},
+        {"import", TokenType::IMPORT},
+        {"nil", TokenType::NIL},
+        {nullptr, TokenType::IDENTIFIER},
+    };
+
+    TokenType keyword(const char* s, std::size_t size) {
+        if (size < 2 || size > 7) {
+            return TokenType::IDENTIFIER;
+        }
+        const Keyword& kw = KEYWORDS[((unsigned char)s[0] + 3 * (unsigned char)s[size - 1] + 4 * size) & 31];
+        if (kw.name && std::strncmp(kw.name, s, size) == 0 && kw.name[size] == '\0') {
+            return kw.type;
+        }
+        return TokenType::IDENTIFIER;
+    }
+
+    static bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static bool is_identifier_char(char c) {
+        return c == '_' || c == '$' || std::isalnum((unsigned char)c);
+    }
+
     Lexer::Lexer(const std::string& text, const std::string& filename)
-        : text(text), current('\0'), pos(0), line(1), filename(filename) {
-        advance();
+        : Lexer(text.data(), text.size(), filename) {
+    }
+
+    Lexer::Lexer(const char* text, std::size_t size, const std::string& filename)
+        : text(text), size(size), filename(filename), current(size ? text[0] : '\0'), pos(0), line(current == '\n' ? 2 : 1) {
     }
 
+    // pos is always the offset of current, so a token's text runs from where it started to pos
     void Lexer::advance() {
-        if (pos < (int)text.length()) {
-            current = text.at(pos);
+        if (pos < size) {
             pos++;
-            if (current == '\n') {
-                line++;
-            }
         }
-        else {
-            current = '\0';
+        current = pos < size ? text[pos] : '\0';
+        if (current == '\n') {
+            line++;
         }
     }
 
     std::vector<Token> Lexer::generate_tokens() {
         std::vector<Token> tokens;
+        // Typical code has a token every four or five characters
+        tokens.reserve(size / 4 + 1);
         while (current != '\0') {
-            if (isspace(current)) {
+            if (std::isspace((unsigned char)current)) {
                 advance();
             }
-            else if (isdigit(current)) {
+            else if (is_digit(current)) {
                 tokens.push_back(generate_number());
             }
-            else if (current == '_' || current == '$' || isalpha(current)) {
+            else if (current == '_' || current == '$' || std::isalpha((unsigned char)current)) {
                 tokens.push_back(generate_identifier());
             }
             else if (current == '\'') {
+                std::size_t start = pos;
                 advance();
-                char val = current;
                 advance();
                 if(current == '\'') {
-                    tokens.push_back(Token(TokenType::CHAR, std::string("'") + val + std::string("'"), line));
+                    tokens.push_back(Token(TokenType::CHAR, StringView(text + start, 3), line));
                     advance();
                 }
             }            
@@ -68,7 +132,7 @@ namespace tachyon {
                         advance();
                     }
                 } else {
-                    tokens.push_back(Token(TokenType::EQ, "=", ln));
+                    tokens.push_back(Token(TokenType::DIV, "/", ln));
                 }
             }
             else if (current == '%') {
@@ -160,7 +224,7 @@ namespace tachyon {
                 advance();
             }
             else if (current == '[') {
-                tokens.push_back(Token(TokenType::LSQUARE, "[]", line));
+                tokens.push_back(Token(TokenType::LSQUARE, "[", line));
                 advance();
             }
             else if (current == ']') {
@@ -194,58 +258,49 @@ namespace tachyon {
     }
 
     Token Lexer::generate_number() {
-        std::string number_str;
+        std::size_t start = pos;
         int decimal_point_count = 0;
-        while (current != '\0' && (current == '.' || isdigit(current))) {
+        while (current != '\0' && (current == '.' || is_digit(current))) {
             if (current == '.') {
                 decimal_point_count++;
                 if (decimal_point_count >= 2) {
                     break;
                 }
             }
-
-            number_str = number_str + current;
             advance();
         }
 
         if(current == 'e' || current == 'E') {
-            number_str = number_str + current;
             advance();
 
             if(current == '+' || current == '-') {
-                number_str = number_str + current;
                 advance();
             }
             
-            while (current != '\0' && isdigit(current)) {
-                number_str = number_str + current;
+            while (current != '\0' && is_digit(current)) {
                 advance();
             }
         }
 
-        return Token(TokenType::NUMBER, number_str, line);
+        return Token(TokenType::NUMBER, StringView(text + start, pos - start), line);
     }
 
     Token Lexer::generate_string() {
         advance();
-        std::string str;
+        std::size_t start = pos;
         while (current != '\0' && current != '"') {
-            str = str + current;
             advance();
         }
+        std::size_t end = pos;
         advance();
-        return Token(TokenType::STRING, str, line);
+        return Token(TokenType::STRING, StringView(text + start, end - start), line);
     }
 
     Token Lexer::generate_identifier() {
-        std::string identifier_str;
-        while (current != '\0' && (current == '_' || current == '$' || isalnum(current))) {
-            identifier_str = identifier_str + current;
+        std::size_t start = pos;
+        while (current != '\0' && is_identifier_char(current)) {
             advance();
         }
-        if (KEYWORDS.count(identifier_str)) {
-            return Token(KEYWORDS.at(identifier_str), identifier_str, line);
-        }
-        return Token(TokenType::IDENTIFIER, identifier_str, line);
+        return Token(keyword(text + start, pos - start), StringView(text + start, pos - start), line);
     }
-} // namespace tachyon
\ No newline at end of file
+} // namespace tachyon
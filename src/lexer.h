@@ -3,35 +3,21 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <cstddef>
 #include "token.h"
 
 namespace tachyon {
-    const std::map<std::string, TokenType> KEYWORDS{
-        {"nil", TokenType::NIL},
-        {"true", TokenType::TRUE},
-        {"false", TokenType::FALSE},
-        {"var", TokenType::VAR},
-        {"block", TokenType::BLOCK},
-        {"if", TokenType::IF},
-        {"else", TokenType::ELSE},
-        {"while", TokenType::WHILE},
-        {"for", TokenType::FOR},
-        {"def", TokenType::DEF},  
-        {"lambda", TokenType::LAMBDA},
-        {"return", TokenType::RETURN},
-        {"import", TokenType::IMPORT},
-        {"cimport", TokenType::CIMPORT},
-        {"try", TokenType::TRY},
-        {"catch", TokenType::CATCH},
-    };
+    // Looks up a keyword by its text in a perfect hash table, returning IDENTIFIER for other names
+    TokenType keyword(const char* s, std::size_t size);
 
+    // Scans the text in place, so its tokens point into it and it has to outlive them
     class Lexer {
     private:
-        std::string text{};
+        const char* text;
+        std::size_t size;
         std::string filename{};
         char current;
-        int pos;
+        std::size_t pos;
         int line;
         void advance();
         Token generate_number();
@@ -39,9 +25,11 @@ namespace tachyon {
         Token generate_identifier();
     public:
         Lexer(const std::string& text, const std::string& filename);
+        Lexer(std::string&& text, const std::string& filename) = delete;
+        Lexer(const char* text, std::size_t size, const std::string& filename);
         std::vector<Token> generate_tokens();
     };
 } // namespace tachyon
 
 
-#endif // LEXER_H
\ No newline at end of file
+#endif // LEXER_H
@@ -4,46 +4,746 @@
 #include <memory>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <exception>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include "token.h"
 #include "lexer.h"
 #include "node.h"
 #include "parser.h"
+#include "optimizer.h"
+#include "inferrer.h"
 #include "transpiler.h"
+#include "module.h"
+#include "serializer.h"
+#include "cache.h"
 
-void transpile(const std::string& filename, const std::string& text, bool i) {
-    tachyon::Lexer lexer(text, filename);
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#define popen _popen
+#define pclose _pclose
+#else
+#include <cerrno>
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#ifndef TACHYON_RUNTIME_DIR
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#define TACHYON_RUNTIME_DIR "C:/Program Files/tachyon"
+#else
+#define TACHYON_RUNTIME_DIR "/usr/local/lib/tachyon"
+#endif
+#endif
+
+// Stops the build if a step failed, saying how it ended. status is what system() or waitpid() gave.
+void check_status(const std::string& command, int status) {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    if (status != 0) {
+        throw std::string("Command failed with exit code " + std::to_string(status) + ": " + command);
+    }
+#else
+    if (status == -1) {
+        throw std::string("Could not run command: " + command);
+    }
+    if (WIFSIGNALED(status)) {
+        throw std::string("Command killed by signal " + std::to_string(WTERMSIG(status)) + ": " + command);
+    }
+    if (WEXITSTATUS(status) != 0) {
+        throw std::string("Command failed with exit code " + std::to_string(WEXITSTATUS(status)) + ": " + command);
+    }
+#endif
+}
+
+// Runs a step of the build, which stops it if the step fails
+void run(const std::string& command) {
+    check_status(command, system(command.c_str()));
+}
+
+// A command whose standard input is written through this buffer, so generated code goes straight
+// into clang++ in chunks instead of through a temporary file. The command is run by the shell, as
+// with run.
+class CommandPipe: public std::streambuf {
+private:
+    std::string command;
+    char buf[64 * 1024];
+    bool finished;
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    FILE* child;
+#else
+    pid_t pid;
+    int fd;
+    // Set if the command stopped reading, in which case the rest of the input is dropped
+    bool broken;
+#endif
+    void send();
+protected:
+    int overflow(int c);
+    int sync();
+public:
+    explicit CommandPipe(const std::string& command);
+    CommandPipe(const CommandPipe&) = delete;
+    CommandPipe& operator=(const CommandPipe&) = delete;
+    ~CommandPipe();
+    void finish();
+};
+
+CommandPipe::CommandPipe(const std::string& command)
+    : command(command), finished(false) {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    child = _popen(command.c_str(), "wb");
+    if (!child) {
+        throw std::string("Could not run command: " + command);
+    }
+#else
+    // A compiler that exits early must not take tachyonc down with it
+    signal(SIGPIPE, SIG_IGN);
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::string("Could not run command: " + command);
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], 0);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    const char* argv[] = {"sh", "-c", command.c_str(), nullptr};
+    int error = posix_spawn(&pid, "/bin/sh", &actions, nullptr, const_cast<char* const*>(argv), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (error != 0) {
+        close(fds[1]);
+        throw std::string("Could not run command: " + command);
+    }
+    fd = fds[1];
+    broken = false;
+#endif
+    setp(buf, buf + sizeof(buf));
+}
+
+// Waits for the command if finish wasn't reached, because writing the code failed
+CommandPipe::~CommandPipe() {
+    if (!finished) {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+        _pclose(child);
+#else
+        close(fd);
+        int status;
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+        }
+#endif
+    }
+}
+
+void CommandPipe::send() {
+    const char* data = pbase();
+    std::size_t size = pptr() - pbase();
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    fwrite(data, 1, size, child);
+#else
+    while (size && !broken) {
+        ssize_t n = write(fd, data, size);
+        if (n >= 0) {
+            data += n;
+            size -= n;
+        }
+        else if (errno != EINTR) {
+            broken = true;
+        }
+    }
+#endif
+    setp(buf, buf + sizeof(buf));
+}
+
+int CommandPipe::overflow(int c) {
+    send();
+    if (c != traits_type::eof()) {
+        *pptr() = (char)c;
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int CommandPipe::sync() {
+    send();
+    return 0;
+}
+
+// Closes the command's input and waits for it to exit, stopping the build if it failed
+void CommandPipe::finish() {
+    send();
+    finished = true;
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    check_status(command, _pclose(child));
+#else
+    close(fd);
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            throw std::string("Could not run command: " + command);
+        }
+    }
+    check_status(command, status);
+    if (broken) {
+        throw std::string("Command stopped reading its input: " + command);
+    }
+#endif
+}
+
+// Runs command with what write writes as its standard input
+void run_with_input(const std::string& command, const std::function<void(std::ostream&)>& write) {
+    CommandPipe pipe(command);
+    std::ostream out(&pipe);
+    write(out);
+    pipe.finish();
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream in_file(path, std::ios::binary);
+    std::stringstream str_stream;
+    str_stream << in_file.rdbuf();
+    return str_stream.str();
+}
+
+// Where make installed tachyon.h and the libtachyonrt variants, unless TACHYON_RUNTIME_DIR overrides it
+std::string runtime_dir() {
+    if (const char* dir = std::getenv("TACHYON_RUNTIME_DIR")) {
+        return dir;
+    }
+    return TACHYON_RUNTIME_DIR;
+}
+
+bool file_exists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+// Asked once per run, since every module's cache key needs it
+std::string compiler_version() {
+    static std::string version;
+    if (!version.empty()) {
+        return version;
+    }
+    if (FILE* pipe = popen("clang++ --version", "r")) {
+        char buf[256];
+        while (std::size_t n = fread(buf, 1, sizeof(buf), pipe)) {
+            version.append(buf, n);
+        }
+        pclose(pipe);
+    }
+    return version;
+}
+
+// Hash of everything the binary is built from, including the runtime it links against. Headers
+// included with cimport are looked up next to the generated file first, as clang++ does.
+std::string cache_key(const std::string& code, const std::string& dir, const std::vector<std::string>& headers,
+    const std::string& flags, const std::vector<std::string>& runtime, bool pgo, const std::string& pgo_input) {
+    std::string key = code + '\0' + flags + '\0' + compiler_version();
+    for (const std::string& file : runtime) {
+        key += '\0' + read_file(file);
+    }
+    for (const std::string& header : headers) {
+        std::string contents = read_file(dir + header);
+        key += '\0' + header + '\0' + (contents.empty() ? read_file(header) : contents);
+    }
+    if (pgo) {
+        key += "\0pgo\0" + read_file(pgo_input);
+    }
+    return tachyon::sha256(key);
+}
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+const std::string exe_ext = ".exe";
+#else
+const std::string exe_ext = "";
+#endif
+
+// Everything before the file's extension, which is where its generated files go
+std::string strip_ext(const std::string& filename) {
+    return filename.substr(0, filename.size() - 8);
+}
+
+std::string dir_of(const std::string& filename) {
+    std::size_t slash = filename.find_last_of("/\\");
+    return slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+}
+
+// Lets code read from standard input include headers next to its source file, as it could from a file there
+std::string iquote(const std::string& dir) {
+    return dir.empty() ? "" : " -iquote \"" + dir + "\"";
+}
+
+// Absolute path with links resolved, so every spelling of a file names the same module
+std::string canonical_path(const std::string& path) {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    char buf[_MAX_PATH];
+    if (_fullpath(buf, path.c_str(), _MAX_PATH)) {
+        return buf;
+    }
+#else
+    if (char* real = realpath(path.c_str(), nullptr)) {
+        std::string result(real);
+        free(real);
+        return result;
+    }
+#endif
+    return path;
+}
+
+// Unique C++ name for the module at path, readable enough to find in a backtrace
+std::string module_id(const std::string& path) {
+    std::string name = strip_ext(path.substr(dir_of(path).size()));
+    std::string id;
+    for (char c : name) {
+        id += isalnum((unsigned char)c) ? c : '_';
+    }
+    return id + "_" + tachyon::sha256(canonical_path(path)).substr(0, 8);
+}
+
+// A file of the program as the front end reads it, before inference
+class ParsedFile {
+public:
+    // As written in the import that found it first, or the program's filename
+    std::string path;
+    tachyon::Arena arena;
+    tachyon::Node* tree{nullptr};
+    std::vector<tachyon::ImportStmtNode*> imports{};
+    // Why it couldn't be read or parsed, which is only reported if the program reaches it
+    std::exception_ptr error{};
+    double seconds{0};
+    double optimize_seconds{0};
+};
+
+// Generated C++ for one imported file, which becomes its own object file. Its level is one more
+// than the highest level of the modules it imports.
+class Unit {
+public:
+    tachyon::Module* module;
+    ParsedFile* file;
+    int level;
+    std::string filename_noext;
+    std::string code;
+    std::string dir;
+    std::vector<std::string> headers;
+    std::string key;
+    double infer_seconds;
+    double transpile_seconds;
+};
+
+// Seconds spent in each phase of one compilation for -time, summed over its files, so with
+// several threads they can add up to more than the time it took
+class Timings {
+public:
+    double parse{0};
+    double optimize{0};
+    double infer{0};
+    double transpile{0};
+    double compile{0};
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void print_timings(const Timings& timings) {
+    std::cerr << std::fixed << std::setprecision(1);
+    std::cerr << "parse:     " << timings.parse * 1000 << " ms" << '\n';
+    std::cerr << "optimize:  " << timings.optimize * 1000 << " ms" << '\n';
+    std::cerr << "infer:     " << timings.infer * 1000 << " ms" << '\n';
+    std::cerr << "transpile: " << timings.transpile * 1000 << " ms" << '\n';
+    std::cerr << "compile:   " << timings.compile * 1000 << " ms" << '\n';
+}
+
+// Every file of one compilation, keyed by canonical path, so each is lexed, parsed and
+// transpiled once however many files import it
+class ModuleTable {
+public:
+    std::map<std::string, std::shared_ptr<ParsedFile> > files;
+    std::map<std::string, std::shared_ptr<tachyon::Module> > modules;
+    std::map<tachyon::Module*, int> levels;
+    std::vector<Unit> units;
+    std::vector<std::string> loading;
+    // Where parsed files are kept between compilations, or nullptr
+    const tachyon::Cache* ast_cache;
+    // Optimizer passes run on each file after it is parsed
+    std::vector<std::string> passes;
+    Timings timings;
+};
+
+// Calls f(0) to f(count - 1) spread over up to one thread per core. f must not throw.
+void parallel_for(std::size_t count, const std::function<void(std::size_t)>& f) {
+    std::size_t threads = std::min<std::size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<std::size_t> next(0);
+    std::function<void()> work = [&]() {
+        for (std::size_t j = next++; j < count; j = next++) {
+            f(j);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < threads; t++) {
+        pool.push_back(std::thread(work));
+    }
+    work();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
+
+// Lexes and parses a file into arena, or loads the tree saved the last time a file with this text was parsed
+tachyon::Node* parse_file(const std::string& path, const std::string& text, const tachyon::Cache* ast_cache,
+    tachyon::Arena& arena, std::vector<tachyon::ImportStmtNode*>& imports) {
+    std::string key;
+    if (ast_cache) {
+        key = tachyon::sha256(std::string("ast") + '\0' + text);
+        std::string data;
+        if (ast_cache->read(key, data)) {
+            try {
+                tachyon::Deserializer deserializer(data, path, arena);
+                tachyon::Node* tree = deserializer.deserialize();
+                imports = deserializer.imports();
+                return tree;
+            }
+            catch (const std::string&) {
+                // Parsed again and overwritten below
+            }
+        }
+    }
+    tachyon::Lexer lexer(text, path);
     std::vector<tachyon::Token> tokens = lexer.generate_tokens();
-    tachyon::Parser parser(tokens, filename);
-    std::shared_ptr<tachyon::Node> tree = parser.parse();
-    tachyon::Transpiler transpiler(filename);
-    std::string filename_noext = filename.substr(0, filename.size() - 8);
+    tachyon::Parser parser(tokens, path, arena);
+    tachyon::Node* tree = parser.parse();
+    imports = parser.imports();
+    if (ast_cache) {
+        tachyon::Serializer serializer;
+        ast_cache->write(key, serializer.serialize(tree));
+    }
+    return tree;
+}
+
+// Reads and parses the program and every file it imports, one level of the import graph at a
+// time with the files of a level parsed at once. Files are found in the same order whatever the
+// threads do, so the program compiles the same way every time.
+void parse_files(const std::string& filename, const std::string& text, ModuleTable& table) {
+    std::shared_ptr<ParsedFile> program(new ParsedFile());
+    program->path = filename;
+    table.files[canonical_path(filename)] = program;
+    std::vector<ParsedFile*> level = {program.get()};
+    while (!level.empty()) {
+        parallel_for(level.size(), [&](std::size_t j) {
+            ParsedFile* file = level[j];
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            try {
+                std::string file_text = file == program.get() ? text : read_file(file->path);
+                if (file_text.empty()) {
+                    throw std::string("Imported file \"" + file->path + "\" is empty or does not exist");
+                }
+                file->tree = parse_file(file->path, file_text, table.ast_cache, file->arena, file->imports);
+                file->seconds = seconds_since(start);
+                start = std::chrono::steady_clock::now();
+                tachyon::Optimizer optimizer(table.passes, file != program.get(), file->arena);
+                file->tree = optimizer.optimize(file->tree);
+                file->optimize_seconds = seconds_since(start);
+            }
+            catch (...) {
+                file->error = std::current_exception();
+                file->seconds = seconds_since(start);
+            }
+        });
+        std::vector<ParsedFile*> next;
+        for (ParsedFile* file : level) {
+            table.timings.parse += file->seconds;
+            table.timings.optimize += file->optimize_seconds;
+            for (tachyon::ImportStmtNode* node : file->imports) {
+                std::string canonical = canonical_path(node->path);
+                if (!table.files.count(canonical)) {
+                    std::shared_ptr<ParsedFile> imported(new ParsedFile());
+                    imported->path = node->path;
+                    table.files[canonical] = imported;
+                    next.push_back(imported.get());
+                }
+            }
+        }
+        level = next;
+    }
+}
+
+// Finds the module at path, after the modules it imports. Units are appended in that order, so a
+// module's imports are always compiled and initialized before it.
+tachyon::Module* load_module(const std::string& path, ModuleTable& table) {
+    std::string canonical = canonical_path(path);
+    std::map<std::string, std::shared_ptr<tachyon::Module> >::iterator it = table.modules.find(canonical);
+    if (it != table.modules.end()) {
+        return it->second.get();
+    }
+    if (std::find(table.loading.begin(), table.loading.end(), canonical) != table.loading.end()) {
+        throw std::string("Circular import of \"" + path + "\"");
+    }
+    ParsedFile* file = table.files.at(canonical).get();
+    if (file->error) {
+        std::rethrow_exception(file->error);
+    }
+    table.loading.push_back(canonical);
+    std::shared_ptr<tachyon::Module> module(new tachyon::Module(file->path, module_id(file->path)));
+    int level = 0;
+    for (tachyon::ImportStmtNode* node : file->imports) {
+        node->module = load_module(node->path, table);
+        level = std::max(level, table.levels[node->module] + 1);
+    }
+    table.levels[module.get()] = level;
+    Unit unit{module.get(), file, level, strip_ext(file->path), "", dir_of(file->path), {}, "", 0, 0};
+    table.units.push_back(unit);
+    table.loading.pop_back();
+    table.modules[canonical] = module;
+    return module.get();
+}
+
+// Infers and transpiles the imported modules, all those of a level at once, since a module only
+// depends on the exports of the modules it imports. If several fail, the error of the first in
+// the order of units is reported.
+void transpile_units(ModuleTable& table) {
+    int levels = 0;
+    for (const Unit& unit : table.units) {
+        levels = std::max(levels, unit.level + 1);
+    }
+    for (int level = 0; level < levels; level++) {
+        std::vector<Unit*> batch;
+        for (Unit& unit : table.units) {
+            if (unit.level == level) {
+                batch.push_back(&unit);
+            }
+        }
+        std::vector<std::exception_ptr> errors(batch.size());
+        parallel_for(batch.size(), [&](std::size_t j) {
+            Unit& unit = *batch[j];
+            try {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                tachyon::Inferrer inferrer(unit.module->path);
+                inferrer.infer(unit.file->tree, unit.module);
+                unit.infer_seconds = seconds_since(start);
+                start = std::chrono::steady_clock::now();
+                tachyon::Transpiler transpiler(unit.module->path);
+                unit.code = transpiler.generate_module(unit.file->tree, *unit.module);
+                unit.headers = transpiler.local_headers();
+                unit.transpile_seconds = seconds_since(start);
+            }
+            catch (...) {
+                errors[j] = std::current_exception();
+            }
+        });
+        for (std::size_t j = 0; j < batch.size(); j++) {
+            if (errors[j]) {
+                std::rethrow_exception(errors[j]);
+            }
+            table.timings.infer += batch[j]->infer_seconds;
+            table.timings.transpile += batch[j]->transpile_seconds;
+        }
+    }
+}
+
+void write_file(const std::string& path, const std::string& text) {
     std::ofstream out_file;
-    out_file.open(filename_noext + ".cpp");
-    out_file << transpiler.generate_code(tree.get());
+    out_file.open(path);
+    out_file << text;
     out_file.close();
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-    // Windows
-    system(("clang++ " + filename_noext + ".cpp -o " + filename_noext + ".exe-std=c++11").c_str());
-    if (!i) {
-        system(("del " + filename_noext + ".cpp").c_str());
+}
+
+void transpile(const std::string& filename, const std::string& text, bool i, const std::string& flags, const std::string& link_flags,
+    const std::vector<std::string>& runtime, bool pgo, const std::string& pgo_input, bool cache, bool ast_cache, bool time,
+    const std::vector<std::string>& passes, bool dump_ast) {
+    std::string cache_dir = (cache || ast_cache) ? tachyon::Cache::default_dir() : "";
+    tachyon::Cache build_cache(cache_dir);
+    ModuleTable table;
+    table.ast_cache = (ast_cache && !cache_dir.empty()) ? &build_cache : nullptr;
+    table.passes = passes;
+    // The program itself can't be imported
+    table.loading.push_back(canonical_path(filename));
+    parse_files(filename, text, table);
+    ParsedFile* program = table.files.at(canonical_path(filename)).get();
+    if (program->error) {
+        std::rethrow_exception(program->error);
+    }
+    for (tachyon::ImportStmtNode* node : program->imports) {
+        node->module = load_module(node->path, table);
+    }
+    if (dump_ast) {
+        // Imported files first, in the order they are initialized
+        for (const Unit& unit : table.units) {
+            std::cout << "// " << unit.file->path << '\n' << unit.file->tree->str() << '\n';
+        }
+        std::cout << "// " << filename << '\n' << program->tree->str() << '\n';
+        return;
+    }
+    transpile_units(table);
+    tachyon::Node* tree = program->tree;
+    std::vector<Unit>& units = table.units;
+    std::vector<tachyon::Module*> imported;
+    for (const Unit& unit : units) {
+        imported.push_back(unit.module);
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    tachyon::Inferrer inferrer(filename);
+    inferrer.infer(tree);
+    table.timings.infer += seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    tachyon::Transpiler transpiler(filename);
+    std::string filename_noext = strip_ext(filename);
+    transpiler.translate(tree);
+    // The program is only put together in one string if its cache key or -i needs it. Otherwise
+    // it is written straight from the Transpiler into clang++.
+    std::string code;
+    bool use_cache = cache && !cache_dir.empty();
+    if (i || use_cache) {
+        std::ostringstream out;
+        transpiler.write_code(out, imported);
+        code = out.str();
+    }
+    table.timings.transpile += seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    std::vector<std::string> temp_files;
+    if (i) {
+        write_file(filename_noext + ".cpp", code);
+        for (const Unit& unit : units) {
+            write_file(unit.filename_noext + ".cpp", unit.code);
+        }
+    }
+    for (const Unit& unit : units) {
+        temp_files.push_back(unit.filename_noext + ".o");
+    }
+    std::string key;
+    if (use_cache) {
+        // A module's object file only depends on its own code, which names the slots of what it imports
+        std::string all_code = code;
+        for (Unit& unit : units) {
+            unit.key = cache_key(unit.code, unit.dir, unit.headers, flags, runtime, false, "");
+            all_code += '\0' + unit.key;
+        }
+        key = cache_key(all_code, dir_of(filename), transpiler.local_headers(), flags + link_flags, runtime, pgo, pgo_input);
     }
+    std::string exe = filename_noext + exe_ext;
+    if (!key.empty() && build_cache.fetch(key, exe)) {
+        if (!i) {
+            for (const std::string& file : temp_files) {
+                std::remove(file.c_str());
+            }
+        }
+        table.timings.compile += seconds_since(start);
+        if (time) {
+            print_timings(table.timings);
+        }
+        return;
+    }
+    // Unchanged modules are linked from the cache. Instrumented and profile-guided objects
+    // depend on the training run, so they are always rebuilt. Without -i, code is piped into
+    // clang++, which then looks for cimported headers in the source's directory with -iquote.
+    std::function<void(const std::string&)> build = [&](const std::string& extra) {
+        std::string objects;
+        for (const Unit& unit : units) {
+            std::string object = unit.filename_noext + ".o";
+            if (extra.empty() && !unit.key.empty() && build_cache.fetch(unit.key, object)) {
+                objects += " " + object;
+                continue;
+            }
+            if (i) {
+                run("clang++ -c " + unit.filename_noext + ".cpp -o " + object + flags + extra);
+            }
+            else {
+                run_with_input("clang++ -x c++ - -c -o " + object + iquote(unit.dir) + flags + extra, [&](std::ostream& out) {
+                    out << unit.code;
+                });
+            }
+            if (extra.empty() && !unit.key.empty()) {
+                build_cache.store(unit.key, object);
+            }
+            objects += " " + object;
+        }
+        if (i) {
+            run("clang++ " + filename_noext + ".cpp" + objects + " -o " + exe + flags + extra + link_flags);
+        }
+        else {
+            run_with_input("clang++ -x c++ - -x none" + objects + " -o " + exe + iquote(dir_of(filename)) + flags + extra + link_flags,
+                [&](std::ostream& out) {
+                    if (!code.empty()) {
+                        out << code;
+                    }
+                    else {
+                        transpiler.write_code(out, imported);
+                    }
+                });
+        }
+    };
+    if (pgo) {
+        // Train an instrumented build on the input, then rebuild using the merged profile
+        build(" -fprofile-generate");
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+        run("set \"LLVM_PROFILE_FILE=" + filename_noext + ".profraw\" && " + exe + " < " + (pgo_input.empty() ? "NUL" : pgo_input));
 #else
-    // Linux and Mac
-    system(("clang++ " + filename_noext + ".cpp -o " + filename_noext + " -std=c++11").c_str());
+        std::string command = exe.find('/') == std::string::npos ? "./" + exe : exe;
+        run("LLVM_PROFILE_FILE=" + filename_noext + ".profraw " + command + " < " + (pgo_input.empty() ? "/dev/null" : pgo_input));
+#endif
+        run("llvm-profdata merge -output=" + filename_noext + ".profdata " + filename_noext + ".profraw");
+        temp_files.push_back(filename_noext + ".profraw");
+        temp_files.push_back(filename_noext + ".profdata");
+        build(" -fprofile-use=" + filename_noext + ".profdata");
+    }
+    else {
+        build("");
+    }
+    if (!key.empty()) {
+        build_cache.store(key, exe);
+    }
+    // Only builds that stored something can take the cache over its size limit
+    build_cache.trim();
     if (!i) {
-        system(("rm -rf " + filename_noext + ".cpp").c_str());
+        for (const std::string& file : temp_files) {
+            std::remove(file.c_str());
+        }
+    }
+    table.timings.compile += seconds_since(start);
+    if (time) {
+        print_timings(table.timings);
     }
-#endif
-    std::size_t idx = filename.find_last_of("/\\");
 }
 
 int main(int argc, char** argv) {
+    if (argc == 2 && std::string(argv[1]) == "-clearcache") {
+        std::string cache_dir = tachyon::Cache::default_dir();
+        if (!cache_dir.empty()) {
+            tachyon::Cache(cache_dir).clear();
+        }
+        return 0;
+    }
     if ((argc < 2)) {
         std::cerr << "Usage: tachyonc [file]" << '\n';
+        std::cerr << "       tachyonc -clearcache: Delete everything in the build cache" << '\n';
         std::cerr << "Options (must be added after filename):" << '\n';
         std::cerr << "-i: Keep intermediate C++ file" << '\n';
+        std::cerr << "-nanbox: Use NaN-boxed 8-byte values" << '\n';
+        std::cerr << "-O0, -O1, -O2, -O3, -Os, -Oz: Optimization level (default -O0)" << '\n';
+        std::cerr << "-march=[cpu]: Target CPU, e.g. -march=native" << '\n';
+        std::cerr << "-lto: Link-time optimization" << '\n';
+        std::cerr << "-ndebug: Define NDEBUG, which removes the runtime's type assertions" << '\n';
+        std::cerr << "-cxxflags=[flags]: Extra flags for the C++ compiler" << '\n';
+        std::cerr << "-ldflags=[flags]: Extra flags for the linker" << '\n';
+        std::cerr << "-release: Release profile, same as -O2 -lto -ndebug" << '\n';
+        std::cerr << "-pgo[=input]: Profile-guided optimization, training on input as stdin" << '\n';
+        std::cerr << "-nocache: Always run clang++, even if the build cache has this binary" << '\n';
+        std::cerr << "-astcache: Keep parsed files in the build cache, for large libraries" << '\n';
+        std::cerr << "-time: Print how long each phase of the compilation took" << '\n';
+        std::cerr << "-passes=[passes]: Comma-separated optimizer passes to run, from fold and dce (default all)" << '\n';
+        std::cerr << "-dump-ast: Print each file as it is after the optimizer passes, instead of compiling" << '\n';
         return 1;
     }
     else {
@@ -62,13 +762,131 @@ int main(int argc, char** argv) {
             return 0;
         }
 
-        try {
-            if (argc == 3 && std::string(argv[2]) == "-i") {
-                transpile(filename, text, true);
+        bool i = false;
+        bool nanbox = false;
+        // Unoptimized by default to keep the edit-compile-run loop short, and since the precompiled
+        // headers of make pch are only built for -O0. Shipped binaries use -release.
+        std::string opt = "-O0";
+        std::string march;
+        bool lto = false;
+        bool ndebug = false;
+        std::string cxxflags;
+        std::string ldflags;
+        bool pgo = false;
+        std::string pgo_input;
+        bool cache = true;
+        bool ast_cache = false;
+        bool time = false;
+        std::vector<std::string> passes = tachyon::Optimizer::all_passes;
+        bool dump_ast = false;
+        for (int j = 2; j < argc; j++) {
+            std::string option(argv[j]);
+            if (option == "-i") {
+                i = true;
+            }
+            else if (option == "-nanbox") {
+                nanbox = true;
+            }
+            else if (option == "-O0" || option == "-O1" || option == "-O2" || option == "-O3" || option == "-Os" || option == "-Oz") {
+                opt = option;
+            }
+            else if (option.compare(0, 7, "-march=") == 0 && option.size() > 7) {
+                march = option;
+            }
+            else if (option == "-lto") {
+                lto = true;
+            }
+            else if (option == "-ndebug") {
+                ndebug = true;
+            }
+            else if (option.compare(0, 10, "-cxxflags=") == 0) {
+                cxxflags += " " + option.substr(10);
+            }
+            else if (option.compare(0, 9, "-ldflags=") == 0) {
+                ldflags += " " + option.substr(9);
+            }
+            else if (option == "-pgo") {
+                pgo = true;
+            }
+            else if (option.compare(0, 5, "-pgo=") == 0) {
+                pgo = true;
+                pgo_input = option.substr(5);
+            }
+            else if (option == "-nocache") {
+                cache = false;
+            }
+            else if (option == "-astcache") {
+                ast_cache = true;
+            }
+            else if (option == "-time") {
+                time = true;
+            }
+            else if (option.compare(0, 8, "-passes=") == 0) {
+                passes.clear();
+                std::stringstream list(option.substr(8));
+                std::string pass;
+                while (std::getline(list, pass, ',')) {
+                    if (std::find(tachyon::Optimizer::all_passes.begin(), tachyon::Optimizer::all_passes.end(), pass) == tachyon::Optimizer::all_passes.end()) {
+                        std::cerr << "Unknown optimizer pass \"" + pass + "\"" << '\n';
+                        return 1;
+                    }
+                    passes.push_back(pass);
+                }
+            }
+            else if (option == "-dump-ast") {
+                dump_ast = true;
+            }
+            else if (option == "-release") {
+                // Options after -release still override it
+                opt = "-O2";
+                lto = true;
+                ndebug = true;
             }
             else {
-                transpile(filename, text, false);
+                std::cerr << "Unknown option \"" + option + "\"" << '\n';
+                return 1;
+            }
+        }
+
+        std::string flags = " -std=c++11 " + opt;
+        if (!march.empty()) {
+            flags += " " + march;
+        }
+        if (lto) {
+            flags += " -flto";
+        }
+        if (ndebug) {
+            flags += " -DNDEBUG";
+        }
+        if (nanbox) {
+            flags += " -DTACHYON_NAN_BOXING";
+        }
+        // Generated code includes tachyon.h and links against the prebuilt runtime of the same variant
+        std::string dir = runtime_dir();
+        std::string lib = std::string("tachyonrt") + (nanbox ? "-nanbox" : "") + (ndebug ? "-ndebug" : "");
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+        std::string lib_file = dir + "/" + lib + ".lib";
+        std::string link = " -L\"" + dir + "\" -l" + lib;
+#else
+        std::string lib_file = dir + "/lib" + lib + ".a";
+        std::string link = " -L\"" + dir + "\" -l" + lib + " -pthread";
+#endif
+        std::vector<std::string> runtime = {dir + "/tachyon.h", lib_file};
+        flags += " -I\"" + dir + "\"";
+        // A precompiled header is only valid for the flags it was built with, which are those of a default build
+        std::string pch = dir + "/" + lib + ".pch";
+        if (opt == "-O0" && march.empty() && cxxflags.empty() && !pgo && file_exists(pch)) {
+            flags += " -include-pch \"" + pch + "\"";
+        }
+        flags += cxxflags;
+        // Linker flags go after the object files
+        link += ldflags;
+
+        try {
+            if (!dump_ast && !file_exists(lib_file)) {
+                throw std::string("Runtime library " + lib_file + " not found; run make, or set TACHYON_RUNTIME_DIR");
             }
+            transpile(filename, text, i, flags, link, runtime, pgo, pgo_input, cache, ast_cache, time, passes, dump_ast);
             in_file.close();
         }
         catch (const std::string& e) {
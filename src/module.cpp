@@ -0,0 +1,8 @@
+#include <string>
+#include "module.h"
+
+namespace tachyon {
+    Module::Module(const std::string& path, const std::string& id)
+        : path(path), id(id) {
+    }
+} // namespace tachyon
\ No newline at end of file
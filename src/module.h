@@ -0,0 +1,20 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <string>
+#include <vector>
+
+namespace tachyon {
+    // A file brought in with import, which is compiled to its own object file. Its top-level
+    // variables live in the TachyonEnv tachyon_module_<id>, in the order of exports, and its
+    // top-level code runs the first time tachyon_module_<id>_init() is called.
+    class Module {
+    public:
+        std::string path;
+        std::string id;
+        std::vector<std::string> exports{};
+        Module(const std::string& path, const std::string& id);
+    };
+} // namespace tachyon
+
+#endif // MODULE_H
\ No newline at end of file
@@ -1,9 +1,46 @@
 #include <string>
-#include <memory>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
 #include "token.h"
 #include "node.h"
 
 namespace tachyon {
+    static std::string join(const std::vector<std::string>& strings) {
+        std::string result;
+        for (std::size_t i = 0; i < strings.size(); i++) {
+            if (i > 0) {
+                result += ", ";
+            }
+            result += strings[i];
+        }
+        return result;
+    }
+
+    static std::vector<std::string> strs(const std::vector<Node*>& nodes) {
+        std::vector<std::string> result;
+        for (Node* node : nodes) {
+            result.push_back(node->str());
+        }
+        return result;
+    }
+
+    static std::string indent(const std::string& code) {
+        std::string result = "    ";
+        for (char c : code) {
+            result += c;
+            if (c == '\n') {
+                result += "    ";
+            }
+        }
+        return result;
+    }
+
+    Capture::Capture(const std::string& name, ValueType type, int env, int slot)
+        : name(name), type(type), env(env), slot(slot) {
+    }
+
     NilNode::NilNode(int line) {
         this->line = line;
     }
@@ -12,6 +49,10 @@ namespace tachyon {
         return NodeKind::NIL;
     }
 
+    std::string NilNode::str() const {
+        return "nil";
+    }
+
     NumberNode::NumberNode(double val, int line)
         : val(val) {
         this->line = line;
@@ -21,6 +62,17 @@ namespace tachyon {
         return NodeKind::NUMBER;
     }
 
+    std::string NumberNode::str() const {
+        std::ostringstream oss;
+        oss << std::setprecision(15) << val;
+        // strtod, since std::stod throws for subnormal numbers
+        if (std::strtod(oss.str().c_str(), nullptr) != val) {
+            oss.str("");
+            oss << std::setprecision(17) << val;
+        }
+        return oss.str();
+    }
+
     TrueNode::TrueNode(int line) {
         this->line = line;
     }
@@ -29,6 +81,10 @@ namespace tachyon {
         return NodeKind::TRUE;
     }
 
+    std::string TrueNode::str() const {
+        return "true";
+    }
+
     FalseNode::FalseNode(int line) {
         this->line = line;
     }
@@ -37,6 +93,10 @@ namespace tachyon {
         return NodeKind::FALSE;
     }
 
+    std::string FalseNode::str() const {
+        return "false";
+    }
+
     CharNode::CharNode(char val, int line)
         : val(val) {
         this->line = line;
@@ -46,6 +106,10 @@ namespace tachyon {
         return NodeKind::CHAR;
     }
 
+    std::string CharNode::str() const {
+        return std::string("'") + val + "'";
+    }
+
     StringNode::StringNode(const std::string& val, int line)
         : val(val) {
         this->line = line;
@@ -55,6 +119,10 @@ namespace tachyon {
         return NodeKind::STRING;
     }
 
+    std::string StringNode::str() const {
+        return '"' + val + '"';
+    }
+
     IdentifierNode::IdentifierNode(const std::string& val, int line)
         : val(val) {
         this->line = line;
@@ -64,7 +132,11 @@ namespace tachyon {
         return NodeKind::IDENTIFIER;
     }
 
-    ParenExprNode::ParenExprNode(std::shared_ptr<Node> node, int line)
+    std::string IdentifierNode::str() const {
+        return val;
+    }
+
+    ParenExprNode::ParenExprNode(Node* node, int line)
         : node(node) {
         this->line = line;
     }
@@ -73,7 +145,11 @@ namespace tachyon {
         return NodeKind::PAREN_EXPR;
     }
 
-    LambdaExprNode::LambdaExprNode(const std::vector<std::string>& args, std::shared_ptr<Node> body, int line)
+    std::string ParenExprNode::str() const {
+        return "(" + node->str() + ")";
+    }
+
+    LambdaExprNode::LambdaExprNode(const std::vector<std::string>& args, Node* body, int line)
         : args(args), body(body) {
         this->line = line;
     }
@@ -82,7 +158,11 @@ namespace tachyon {
         return NodeKind::LAMBDA_EXPR;
     }
 
-    CallExprNode::CallExprNode(std::shared_ptr<Node> callee, const std::vector<std::shared_ptr<Node> >& args, int line)
+    std::string LambdaExprNode::str() const {
+        return "lambda(" + join(args) + ") " + body->str();
+    }
+
+    CallExprNode::CallExprNode(Node* callee, const std::vector<Node*>& args, int line)
         : callee(callee), args(args) {
         this->line = line;
     }
@@ -90,8 +170,12 @@ namespace tachyon {
     NodeKind CallExprNode::kind() const {
         return NodeKind::CALL_EXPR;
     }
+
+    std::string CallExprNode::str() const {
+        return callee->str() + "(" + join(strs(args)) + ")";
+    }
     
-    AttrExprNode::AttrExprNode(const std::shared_ptr<Node> object, const std::string& attr, int line)
+    AttrExprNode::AttrExprNode(Node* object, const std::string& attr, int line)
         : object(object), attr(attr) {
         this->line = line;
     }
@@ -99,8 +183,12 @@ namespace tachyon {
     NodeKind AttrExprNode::kind() const {
         return NodeKind::ATTR_EXPR;
     }
+
+    std::string AttrExprNode::str() const {
+        return object->str() + "." + attr;
+    }
     
-    UnaryExprNode::UnaryExprNode(Token op, std::shared_ptr<Node> node, int line)
+    UnaryExprNode::UnaryExprNode(Token op, Node* node, int line)
         : op(op), node(node) {
         this->line = line;
     }
@@ -109,7 +197,11 @@ namespace tachyon {
         return NodeKind::UNARY_EXPR;
     }
 
-    BinaryExprNode::BinaryExprNode(Token op, std::shared_ptr<Node> node_a, std::shared_ptr<Node> node_b, int line)
+    std::string UnaryExprNode::str() const {
+        return op.val.str() + node->str();
+    }
+
+    BinaryExprNode::BinaryExprNode(Token op, Node* node_a, Node* node_b, int line)
         : op(op), node_a(node_a), node_b(node_b) {
         this->line = line;
     }
@@ -118,7 +210,11 @@ namespace tachyon {
         return NodeKind::BINARY_EXPR;
     }
 
-    ExprStmtNode::ExprStmtNode(std::shared_ptr<Node> node, int line)
+    std::string BinaryExprNode::str() const {
+        return node_a->str() + " " + op.val.str() + " " + node_b->str();
+    }
+
+    ExprStmtNode::ExprStmtNode(Node* node, int line)
         : node(node) {
         this->line = line;
     }
@@ -127,7 +223,11 @@ namespace tachyon {
         return NodeKind::EXPR_STMT;
     }
 
-    VarDeclStmtNode::VarDeclStmtNode(const std::string& name, std::shared_ptr<Node> val, int line)
+    std::string ExprStmtNode::str() const {
+        return node->str() + ";";
+    }
+
+    VarDeclStmtNode::VarDeclStmtNode(const std::string& name, Node* val, int line)
         : name(name), val(val) {
         this->line = line;
     }
@@ -136,7 +236,11 @@ namespace tachyon {
         return NodeKind::VAR_DECL_STMT;
     }
 
-    ObjectNode::ObjectNode(const std::vector<std::string>& keys, const std::vector<std::shared_ptr<Node> >& vals, int line)
+    std::string VarDeclStmtNode::str() const {
+        return "var " + name + " = " + val->str() + ";";
+    }
+
+    ObjectNode::ObjectNode(const std::vector<std::string>& keys, const std::vector<Node*>& vals, int line)
         : keys(keys), vals(vals) {
         this->line = line;
     }
@@ -144,8 +248,16 @@ namespace tachyon {
     NodeKind ObjectNode::kind() const {
         return NodeKind::OBJECT;
     }
+
+    std::string ObjectNode::str() const {
+        std::vector<std::string> fields;
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            fields.push_back(keys[i] + ": " + vals[i]->str());
+        }
+        return "{" + join(fields) + "}";
+    }
     
-    VecNode::VecNode(const std::vector<std::shared_ptr<Node> >& elems, int line)
+    VecNode::VecNode(const std::vector<Node*>& elems, int line)
         : elems(elems) {
         this->line = line;
     }
@@ -154,7 +266,11 @@ namespace tachyon {
         return NodeKind::VEC;
     }
 
-    BlockStmtNode::BlockStmtNode(std::shared_ptr<Node> node, int line)
+    std::string VecNode::str() const {
+        return "[" + join(strs(elems)) + "]";
+    }
+
+    BlockStmtNode::BlockStmtNode(Node* node, int line)
         : node(node) {
         this->line = line;
     }
@@ -163,7 +279,15 @@ namespace tachyon {
         return NodeKind::BLOCK_STMT;
     }
 
-    IfStmtNode::IfStmtNode(std::shared_ptr<Node> test, std::shared_ptr<Node> body, int line)
+    std::string BlockStmtNode::str() const {
+        std::string inner = node->str();
+        if (inner.empty()) {
+            return "{}";
+        }
+        return "{\n" + indent(inner) + "\n}";
+    }
+
+    IfStmtNode::IfStmtNode(Node* test, Node* body, int line)
         : test(test), body(body) {
         this->line = line;
     }
@@ -172,7 +296,11 @@ namespace tachyon {
         return NodeKind::IF_STMT;
     }
 
-    IfElseStmtNode::IfElseStmtNode(std::shared_ptr<Node> test, std::shared_ptr<Node> body, std::shared_ptr<Node> alternate, int line)
+    std::string IfStmtNode::str() const {
+        return "if (" + test->str() + ") " + body->str();
+    }
+
+    IfElseStmtNode::IfElseStmtNode(Node* test, Node* body, Node* alternate, int line)
         : test(test), body(body), alternate(alternate) {
         this->line = line;
     }
@@ -181,7 +309,11 @@ namespace tachyon {
         return NodeKind::IF_ELSE_STMT;
     }
 
-    ForStmtNode::ForStmtNode(std::shared_ptr<Node> init, std::shared_ptr<Node> test, std::shared_ptr<Node> update, std::shared_ptr<Node> body, int line)
+    std::string IfElseStmtNode::str() const {
+        return "if (" + test->str() + ") " + body->str() + " else " + alternate->str();
+    }
+
+    ForStmtNode::ForStmtNode(Node* init, Node* test, Node* update, Node* body, int line)
         : init(init), test(test), update(update), body(body) {
         this->line = line;
     }
@@ -190,7 +322,11 @@ namespace tachyon {
         return NodeKind::FOR_STMT;
     }
 
-    WhileStmtNode::WhileStmtNode(std::shared_ptr<Node> test, std::shared_ptr<Node> body, int line)
+    std::string ForStmtNode::str() const {
+        return "for (" + init->str() + " " + test->str() + "; " + update->str() + ") " + body->str();
+    }
+
+    WhileStmtNode::WhileStmtNode(Node* test, Node* body, int line)
         : test(test), body(body) {
         this->line = line;
     }
@@ -199,7 +335,11 @@ namespace tachyon {
         return NodeKind::WHILE_STMT;
     }
 
-    FuncDeclStmtNode::FuncDeclStmtNode(const std::string& name, const std::vector<std::string>& args, std::shared_ptr<Node> body, int line)
+    std::string WhileStmtNode::str() const {
+        return "while (" + test->str() + ") " + body->str();
+    }
+
+    FuncDeclStmtNode::FuncDeclStmtNode(const std::string& name, const std::vector<std::string>& args, Node* body, int line)
         : name(name), args(args), body(body) {
         this->line = line;
     }
@@ -208,7 +348,11 @@ namespace tachyon {
         return NodeKind::FUNC_DECL_STMT;
     }
 
-    ReturnStmtNode::ReturnStmtNode(std::shared_ptr<Node> node, int line)
+    std::string FuncDeclStmtNode::str() const {
+        return "def " + name + "(" + join(args) + ") " + body->str();
+    }
+
+    ReturnStmtNode::ReturnStmtNode(Node* node, int line)
         : node(node) {
         this->line = line;
     }
@@ -216,7 +360,24 @@ namespace tachyon {
     NodeKind ReturnStmtNode::kind() const {
         return NodeKind::RETURN_STMT;
     }
+
+    std::string ReturnStmtNode::str() const {
+        return "return " + node->str() + ";";
+    }
     
+    ImportStmtNode::ImportStmtNode(const std::string& path, int line)
+        : path(path) {
+        this->line = line;
+    }
+
+    NodeKind ImportStmtNode::kind() const {
+        return NodeKind::IMPORT_STMT;
+    }
+
+    std::string ImportStmtNode::str() const {
+        return "import \"" + path + "\";";
+    }
+
     CImportStmtNode::CImportStmtNode(const std::string& path, int line)
         : path(path) {
         this->line = line;
@@ -226,7 +387,11 @@ namespace tachyon {
         return NodeKind::CIMPORT_STMT;
     }
 
-    TryCatchStmtNode::TryCatchStmtNode(std::shared_ptr<Node> try_body, const std::string& ex, std::shared_ptr<Node> catch_body, int line)
+    std::string CImportStmtNode::str() const {
+        return "cimport \"" + path + "\";";
+    }
+
+    TryCatchStmtNode::TryCatchStmtNode(Node* try_body, const std::string& ex, Node* catch_body, int line)
         : try_body(try_body), ex(ex), catch_body(catch_body) {
         this->line = line;
     }
@@ -235,7 +400,11 @@ namespace tachyon {
         return NodeKind::TRY_CATCH_STMT;
     }
 
-    StmtListNode::StmtListNode(const std::vector<std::shared_ptr<Node> >& stmts, int line)
+    std::string TryCatchStmtNode::str() const {
+        return "try " + try_body->str() + " catch (" + ex + ") " + catch_body->str();
+    }
+
+    StmtListNode::StmtListNode(const std::vector<Node*>& stmts, int line)
         : stmts(stmts) {
         this->line = line;
     }
@@ -243,4 +412,112 @@ namespace tachyon {
     NodeKind StmtListNode::kind() const {
         return NodeKind::STMT_LIST;
     }
+
+    std::string StmtListNode::str() const {
+        std::string result;
+        for (Node* stmt : stmts) {
+            if (!result.empty()) {
+                result += '\n';
+            }
+            result += stmt->str();
+        }
+        return result;
+    }
+
+    std::vector<Node*> children(Node* node) {
+        switch (node->kind()) {
+        case NodeKind::PAREN_EXPR:
+            return {static_cast<ParenExprNode*>(node)->node};
+        case NodeKind::LAMBDA_EXPR:
+            return {static_cast<LambdaExprNode*>(node)->body};
+        case NodeKind::OBJECT: {
+            std::vector<Node*> result;
+            for (Node* val : static_cast<ObjectNode*>(node)->vals) {
+                result.push_back(val);
+            }
+            return result;
+        }
+        case NodeKind::VEC: {
+            std::vector<Node*> result;
+            for (Node* elem : static_cast<VecNode*>(node)->elems) {
+                result.push_back(elem);
+            }
+            return result;
+        }
+        case NodeKind::CALL_EXPR: {
+            CallExprNode* call_expr_node = static_cast<CallExprNode*>(node);
+            std::vector<Node*> result = {call_expr_node->callee};
+            for (Node* arg : call_expr_node->args) {
+                result.push_back(arg);
+            }
+            return result;
+        }
+        case NodeKind::ATTR_EXPR:
+            return {static_cast<AttrExprNode*>(node)->object};
+        case NodeKind::UNARY_EXPR:
+            return {static_cast<UnaryExprNode*>(node)->node};
+        case NodeKind::BINARY_EXPR:
+            return {static_cast<BinaryExprNode*>(node)->node_a, static_cast<BinaryExprNode*>(node)->node_b};
+        case NodeKind::EXPR_STMT:
+            return {static_cast<ExprStmtNode*>(node)->node};
+        case NodeKind::VAR_DECL_STMT:
+            return {static_cast<VarDeclStmtNode*>(node)->val};
+        case NodeKind::BLOCK_STMT:
+            return {static_cast<BlockStmtNode*>(node)->node};
+        case NodeKind::IF_STMT:
+            return {static_cast<IfStmtNode*>(node)->test, static_cast<IfStmtNode*>(node)->body};
+        case NodeKind::IF_ELSE_STMT: {
+            IfElseStmtNode* if_else_stmt_node = static_cast<IfElseStmtNode*>(node);
+            return {if_else_stmt_node->test, if_else_stmt_node->body, if_else_stmt_node->alternate};
+        }
+        case NodeKind::WHILE_STMT:
+            return {static_cast<WhileStmtNode*>(node)->test, static_cast<WhileStmtNode*>(node)->body};
+        case NodeKind::FOR_STMT: {
+            ForStmtNode* for_stmt_node = static_cast<ForStmtNode*>(node);
+            return {for_stmt_node->init, for_stmt_node->test, for_stmt_node->update, for_stmt_node->body};
+        }
+        case NodeKind::FUNC_DECL_STMT:
+            return {static_cast<FuncDeclStmtNode*>(node)->body};
+        case NodeKind::RETURN_STMT:
+            return {static_cast<ReturnStmtNode*>(node)->node};
+        case NodeKind::TRY_CATCH_STMT:
+            return {static_cast<TryCatchStmtNode*>(node)->try_body, static_cast<TryCatchStmtNode*>(node)->catch_body};
+        case NodeKind::STMT_LIST: {
+            std::vector<Node*> result;
+            for (Node* stmt : static_cast<StmtListNode*>(node)->stmts) {
+                result.push_back(stmt);
+            }
+            return result;
+        }
+        default:
+            return {};
+        }
+    }
+
+    // Big enough that even large files only need a few blocks
+    static const std::size_t block_size = 64 * 1024;
+
+    Arena::Arena()
+        : used(block_size) {
+    }
+
+    Arena::~Arena() {
+        for (Node* node : nodes) {
+            node->~Node();
+        }
+        for (char* block : blocks) {
+            delete[] block;
+        }
+    }
+
+    void* Arena::allocate(std::size_t size) {
+        size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+        if (used + size > block_size) {
+            blocks.push_back(new char[block_size]);
+            used = 0;
+        }
+        void* p = blocks.back() + used;
+        used += size;
+        return p;
+    }
 } // namespace tachyon
\ No newline at end of file
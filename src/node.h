@@ -1,9 +1,11 @@
 #ifndef NODE_H
 #define NODE_H
 
-#include <memory>
 #include <string>
 #include <vector>
+#include <cstddef>
+#include <new>
+#include <utility>
 #include "token.h"
 
 namespace tachyon {
@@ -32,15 +34,49 @@ namespace tachyon {
         FOR_STMT,
         FUNC_DECL_STMT,
         RETURN_STMT,
+        IMPORT_STMT,
         CIMPORT_STMT,
         TRY_CATCH_STMT,
         STMT_LIST
     };
 
+    // C++ representation of an expression or variable, filled in by the Inferrer
+    enum class ValueType {
+        DYNAMIC,
+        NUMBER,
+        BOOL,
+        UNKNOWN
+    };
+
+    class FuncDeclStmtNode;
+    class Module;
+
+    // Variables a scope declares that closures capture and that are reassigned, filled in by the
+    // Inferrer. They live in a heap-allocated TachyonEnv created on entry to the scope.
+    class Env {
+    public:
+        int id{-1};
+        std::vector<std::string> vars{};
+    };
+
+    // A variable of an enclosing function that a closure refers to. Variables in an Env are shared
+    // through it, all others are copied into the closure when it is created.
+    class Capture {
+    public:
+        std::string name;
+        ValueType type;
+        int env;
+        int slot;
+        explicit Capture(const std::string& name, ValueType type, int env, int slot);
+    };
+
     class Node {
     public:
         int line;
+        ValueType type{ValueType::DYNAMIC};
         virtual NodeKind kind() const = 0;
+        // Tachyon source for the node, which parses back to an equivalent tree
+        virtual std::string str() const = 0;
         virtual ~Node() = default;
     };
 
@@ -91,6 +127,11 @@ namespace tachyon {
     class IdentifierNode: public Node {
     public:
         std::string val;
+        // The def this names, if it was compiled to a plain C++ function
+        FuncDeclStmtNode* func{nullptr};
+        // Where the variable lives if it is in an Env
+        int env{-1};
+        int slot{-1};
         explicit IdentifierNode(const std::string& val, int line);
         NodeKind kind() const;
         std::string str() const;
@@ -98,8 +139,8 @@ namespace tachyon {
 
     class ParenExprNode: public Node {
     public:
-        std::shared_ptr<Node> node;
-        explicit ParenExprNode(std::shared_ptr<Node> node, int line);
+        Node* node;
+        explicit ParenExprNode(Node* node, int line);
         NodeKind kind() const;
         std::string str() const;
     };
@@ -107,8 +148,10 @@ namespace tachyon {
     class LambdaExprNode: public Node {
     public:
         std::vector<std::string> args;
-        std::shared_ptr<Node> body;
-        explicit LambdaExprNode(const std::vector<std::string>& args, std::shared_ptr<Node> body, int line);
+        Node* body;
+        Env env{};
+        std::vector<Capture> captures{};
+        explicit LambdaExprNode(const std::vector<std::string>& args, Node* body, int line);
         NodeKind kind() const;
         std::string str() const;
     };
@@ -116,34 +159,34 @@ namespace tachyon {
     class ObjectNode: public Node {
     public:
         std::vector<std::string> keys;
-        std::vector<std::shared_ptr<Node> > vals;
-        explicit ObjectNode(const std::vector<std::string>& keys, const std::vector<std::shared_ptr<Node> >& vals, int line);
+        std::vector<Node*> vals;
+        explicit ObjectNode(const std::vector<std::string>& keys, const std::vector<Node*>& vals, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class VecNode: public Node {
     public:
-        std::vector<std::shared_ptr<Node> > elems;
-        explicit VecNode(const std::vector<std::shared_ptr<Node> >& elems, int line);
+        std::vector<Node*> elems;
+        explicit VecNode(const std::vector<Node*>& elems, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class CallExprNode: public Node {
     public:
-        std::shared_ptr<Node> callee;
-        std::vector<std::shared_ptr<Node> > args;
-        explicit CallExprNode(std::shared_ptr<Node> callee, const std::vector<std::shared_ptr<Node> >& args, int line);
+        Node* callee;
+        std::vector<Node*> args;
+        explicit CallExprNode(Node* callee, const std::vector<Node*>& args, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class AttrExprNode: public Node {
     public:
-        std::shared_ptr<Node> object;
+        Node* object;
         std::string attr;
-        explicit AttrExprNode(std::shared_ptr<Node> object, const std::string& attr, int line);
+        explicit AttrExprNode(Node* object, const std::string& attr, int line);
         NodeKind kind() const;
         std::string str() const;
     };
@@ -151,8 +194,8 @@ namespace tachyon {
     class UnaryExprNode: public Node {
     public:
         Token op;
-        std::shared_ptr<Node> node;
-        explicit UnaryExprNode(Token op, std::shared_ptr<Node> node, int line);
+        Node* node;
+        explicit UnaryExprNode(Token op, Node* node, int line);
         NodeKind kind() const;
         std::string str() const;
     };
@@ -160,17 +203,17 @@ namespace tachyon {
     class BinaryExprNode: public Node {
     public:
         Token op;
-        std::shared_ptr<Node> node_a;
-        std::shared_ptr<Node> node_b;
-        explicit BinaryExprNode(Token op, std::shared_ptr<Node> node_a, std::shared_ptr<Node> node_b, int line);
+        Node* node_a;
+        Node* node_b;
+        explicit BinaryExprNode(Token op, Node* node_a, Node* node_b, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class ExprStmtNode: public Node {
     public:
-        std::shared_ptr<Node> node;
-        explicit ExprStmtNode(std::shared_ptr<Node> node, int line);
+        Node* node;
+        explicit ExprStmtNode(Node* node, int line);
         NodeKind kind() const;
         std::string str() const;
     };
@@ -178,55 +221,57 @@ namespace tachyon {
     class VarDeclStmtNode: public Node {
     public:
         std::string name;
-        std::shared_ptr<Node> val;
-        explicit VarDeclStmtNode(const std::string& name, std::shared_ptr<Node> val, int line);
+        Node* val;
+        explicit VarDeclStmtNode(const std::string& name, Node* val, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class BlockStmtNode: public Node {
     public:
-        std::shared_ptr<Node> node;
-        explicit BlockStmtNode(std::shared_ptr<Node> node, int line);
+        Node* node;
+        Env env{};
+        explicit BlockStmtNode(Node* node, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class IfStmtNode: public Node {
     public:
-        std::shared_ptr<Node> test;    
-        std::shared_ptr<Node> body;
-        explicit IfStmtNode(std::shared_ptr<Node> test, std::shared_ptr<Node> body, int line);
+        Node* test;    
+        Node* body;
+        explicit IfStmtNode(Node* test, Node* body, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class IfElseStmtNode: public Node {
     public:
-        std::shared_ptr<Node> test;    
-        std::shared_ptr<Node> body;
-        std::shared_ptr<Node> alternate;
-        explicit IfElseStmtNode(std::shared_ptr<Node> test, std::shared_ptr<Node> body, std::shared_ptr<Node> alternate, int line);
+        Node* test;    
+        Node* body;
+        Node* alternate;
+        explicit IfElseStmtNode(Node* test, Node* body, Node* alternate, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class WhileStmtNode: public Node {
     public:
-        std::shared_ptr<Node> test;    
-        std::shared_ptr<Node> body;
-        explicit WhileStmtNode(std::shared_ptr<Node> test, std::shared_ptr<Node> body, int line);
+        Node* test;    
+        Node* body;
+        explicit WhileStmtNode(Node* test, Node* body, int line);
         NodeKind kind() const;
         std::string str() const;
     };
     
     class ForStmtNode: public Node {
     public:
-        std::shared_ptr<Node> init;    
-        std::shared_ptr<Node> test;    
-        std::shared_ptr<Node> update;    
-        std::shared_ptr<Node> body;
-        explicit ForStmtNode(std::shared_ptr<Node> init, std::shared_ptr<Node> test, std::shared_ptr<Node> update, std::shared_ptr<Node> body, int line);
+        Node* init;    
+        Node* test;    
+        Node* update;    
+        Node* body;
+        Env env{};
+        explicit ForStmtNode(Node* init, Node* test, Node* update, Node* body, int line);
         NodeKind kind() const;
         std::string str() const;
     };
@@ -235,16 +280,36 @@ namespace tachyon {
     public:
         std::string name;
         std::vector<std::string> args;
-        std::shared_ptr<Node> body;
-        explicit FuncDeclStmtNode(const std::string& name, const std::vector<std::string>& args, std::shared_ptr<Node> body, int line);
+        Node* body;
+        // Set by the Inferrer when the def becomes a plain C++ function, with a boxed wrapper if it escapes
+        std::vector<ValueType> arg_types{};
+        bool direct{false};
+        bool escapes{false};
+        // Otherwise it is a closure like a lambda, which refers to itself if it is recursive
+        Env env{};
+        std::vector<Capture> captures{};
+        bool recursive{false};
+        explicit FuncDeclStmtNode(const std::string& name, const std::vector<std::string>& args, Node* body, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class ReturnStmtNode: public Node {
     public:
-        std::shared_ptr<Node> node;
-        explicit ReturnStmtNode(std::shared_ptr<Node> node, int line);
+        Node* node;
+        explicit ReturnStmtNode(Node* node, int line);
+        NodeKind kind() const;
+        std::string str() const;
+    };
+
+    // Brings the top-level variables of a separately compiled file into scope. They are reached
+    // through the module's TachyonEnv, which the Inferrer gives an Env here.
+    class ImportStmtNode: public Node {
+    public:
+        std::string path;
+        Module* module{nullptr};
+        Env env{};
+        explicit ImportStmtNode(const std::string& path, int line);
         NodeKind kind() const;
         std::string str() const;
     };
@@ -259,21 +324,50 @@ namespace tachyon {
 
     class TryCatchStmtNode: public Node {
     public:
-        std::shared_ptr<Node> try_body;
+        Node* try_body;
         std::string ex;
-        std::shared_ptr<Node> catch_body;
-        explicit TryCatchStmtNode(std::shared_ptr<Node> try_body, const std::string& ex, std::shared_ptr<Node> catch_body, int line);
+        Node* catch_body;
+        Env env{};
+        explicit TryCatchStmtNode(Node* try_body, const std::string& ex, Node* catch_body, int line);
         NodeKind kind() const;
         std::string str() const;
     };
 
     class StmtListNode: public Node {
     public:
-        std::vector<std::shared_ptr<Node> > stmts;
-        explicit StmtListNode(const std::vector<std::shared_ptr<Node> >& stmts, int line);
+        std::vector<Node*> stmts;
+        // Only used for the whole program
+        Env env{};
+        explicit StmtListNode(const std::vector<Node*>& stmts, int line);
         NodeKind kind() const;
         std::string str() const;
     };
+
+    // The nodes directly below node, in the order they are evaluated
+    std::vector<Node*> children(Node* node);
+
+    // Owns the nodes of a file's tree, which are bump-allocated from large blocks and all freed
+    // with the arena. Nodes refer to each other by plain pointers, so the arena has to outlive
+    // every pass over the tree.
+    class Arena {
+    private:
+        std::vector<char*> blocks{};
+        std::size_t used;
+        std::vector<Node*> nodes{};
+        void* allocate(std::size_t size);
+    public:
+        Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        ~Arena();
+
+        template<class T, class... Args>
+        T* make(Args&&... args) {
+            T* node = new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+            nodes.push_back(node);
+            return node;
+        }
+    };
 } // namespace tachyon
 
 #endif // NODE_H
\ No newline at end of file
@@ -0,0 +1,438 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdint>
+#include "node.h"
+#include "optimizer.h"
+
+namespace tachyon {
+    const std::vector<std::string> Optimizer::all_passes = {"fold", "dce"};
+
+    Optimizer::Optimizer(const std::vector<std::string>& passes, bool module, Arena& arena)
+        : passes(passes), module(module), arena(arena) {
+    }
+
+    // Where each child of node is kept, so a pass can replace it
+    static std::vector<Node**> slots(Node* node) {
+        switch (node->kind()) {
+        case NodeKind::PAREN_EXPR:
+            return {&static_cast<ParenExprNode*>(node)->node};
+        case NodeKind::LAMBDA_EXPR:
+            return {&static_cast<LambdaExprNode*>(node)->body};
+        case NodeKind::OBJECT: {
+            std::vector<Node**> result;
+            for (Node*& val : static_cast<ObjectNode*>(node)->vals) {
+                result.push_back(&val);
+            }
+            return result;
+        }
+        case NodeKind::VEC: {
+            std::vector<Node**> result;
+            for (Node*& elem : static_cast<VecNode*>(node)->elems) {
+                result.push_back(&elem);
+            }
+            return result;
+        }
+        case NodeKind::CALL_EXPR: {
+            CallExprNode* call_expr_node = static_cast<CallExprNode*>(node);
+            std::vector<Node**> result = {&call_expr_node->callee};
+            for (Node*& arg : call_expr_node->args) {
+                result.push_back(&arg);
+            }
+            return result;
+        }
+        case NodeKind::ATTR_EXPR:
+            return {&static_cast<AttrExprNode*>(node)->object};
+        case NodeKind::UNARY_EXPR:
+            return {&static_cast<UnaryExprNode*>(node)->node};
+        case NodeKind::BINARY_EXPR:
+            return {&static_cast<BinaryExprNode*>(node)->node_a, &static_cast<BinaryExprNode*>(node)->node_b};
+        case NodeKind::EXPR_STMT:
+            return {&static_cast<ExprStmtNode*>(node)->node};
+        case NodeKind::VAR_DECL_STMT:
+            return {&static_cast<VarDeclStmtNode*>(node)->val};
+        case NodeKind::BLOCK_STMT:
+            return {&static_cast<BlockStmtNode*>(node)->node};
+        case NodeKind::IF_STMT:
+            return {&static_cast<IfStmtNode*>(node)->test, &static_cast<IfStmtNode*>(node)->body};
+        case NodeKind::IF_ELSE_STMT: {
+            IfElseStmtNode* if_else_stmt_node = static_cast<IfElseStmtNode*>(node);
+            return {&if_else_stmt_node->test, &if_else_stmt_node->body, &if_else_stmt_node->alternate};
+        }
+        case NodeKind::WHILE_STMT:
+            return {&static_cast<WhileStmtNode*>(node)->test, &static_cast<WhileStmtNode*>(node)->body};
+        case NodeKind::FOR_STMT: {
+            ForStmtNode* for_stmt_node = static_cast<ForStmtNode*>(node);
+            return {&for_stmt_node->init, &for_stmt_node->test, &for_stmt_node->update, &for_stmt_node->body};
+        }
+        case NodeKind::FUNC_DECL_STMT:
+            return {&static_cast<FuncDeclStmtNode*>(node)->body};
+        case NodeKind::RETURN_STMT:
+            return {&static_cast<ReturnStmtNode*>(node)->node};
+        case NodeKind::TRY_CATCH_STMT:
+            return {&static_cast<TryCatchStmtNode*>(node)->try_body, &static_cast<TryCatchStmtNode*>(node)->catch_body};
+        case NodeKind::STMT_LIST: {
+            std::vector<Node**> result;
+            for (Node*& stmt : static_cast<StmtListNode*>(node)->stmts) {
+                result.push_back(&stmt);
+            }
+            return result;
+        }
+        default:
+            return {};
+        }
+    }
+
+    static bool is_number(Node* node, double& val) {
+        if (node->kind() == NodeKind::NUMBER) {
+            val = static_cast<NumberNode*>(node)->val;
+            return true;
+        }
+        return false;
+    }
+
+    static bool is_bool(Node* node, bool& val) {
+        if (node->kind() == NodeKind::TRUE || node->kind() == NodeKind::FALSE) {
+            val = node->kind() == NodeKind::TRUE;
+            return true;
+        }
+        return false;
+    }
+
+    // Converts to int64_t the way the runtime's bitwise operators do, if that is defined
+    static bool is_integer(double val, int64_t& result) {
+        if (std::fabs(val) > 9007199254740992.0) {
+            return false;
+        }
+        result = (int64_t)val;
+        return true;
+    }
+
+    // Literals == can compare. Chars are left alone, since == gives nil for them, and strings
+    // are never equal to anything, because every evaluation of a string literal makes a new object.
+    static bool is_comparable(Node* node) {
+        switch (node->kind()) {
+        case NodeKind::NIL:
+        case NodeKind::NUMBER:
+        case NodeKind::TRUE:
+        case NodeKind::FALSE:
+        case NodeKind::STRING:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool literals_equal(Node* a, Node* b) {
+        if (a->kind() == NodeKind::STRING || a->kind() != b->kind()) {
+            return false;
+        }
+        if (a->kind() == NodeKind::NUMBER) {
+            return static_cast<NumberNode*>(a)->val == static_cast<NumberNode*>(b)->val;
+        }
+        return true;
+    }
+
+    // Whether evaluating node can have no effect, not even a failed type assertion
+    static bool is_pure(Node* node) {
+        switch (node->kind()) {
+        case NodeKind::NIL:
+        case NodeKind::NUMBER:
+        case NodeKind::TRUE:
+        case NodeKind::FALSE:
+        case NodeKind::CHAR:
+        case NodeKind::STRING:
+        case NodeKind::IDENTIFIER:
+        case NodeKind::LAMBDA_EXPR:
+            return true;
+        case NodeKind::PAREN_EXPR:
+        case NodeKind::OBJECT:
+        case NodeKind::VEC:
+            for (Node** child : slots(node)) {
+                if (!is_pure(*child)) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    Node* Optimizer::fold(Node* node) {
+        for (Node** child : slots(node)) {
+            *child = fold(*child);
+        }
+        switch (node->kind()) {
+        case NodeKind::UNARY_EXPR:
+            return fold_unary(static_cast<UnaryExprNode*>(node));
+        case NodeKind::BINARY_EXPR:
+            return fold_binary(static_cast<BinaryExprNode*>(node));
+        case NodeKind::PAREN_EXPR: {
+            Node* inner = static_cast<ParenExprNode*>(node)->node;
+            double n;
+            bool b;
+            if (is_number(inner, n) || is_bool(inner, b) || inner->kind() == NodeKind::NIL) {
+                return inner;
+            }
+            return node;
+        }
+        default:
+            return node;
+        }
+    }
+
+    Node* Optimizer::fold_unary(UnaryExprNode* node) {
+        double a;
+        if (is_number(node->node, a)) {
+            return arena.make<NumberNode>(node->op.val == "-" ? -a : a, node->line);
+        }
+        return node;
+    }
+
+    // Only results the Transpiler can write as a literal are folded, so not infinities or NaN
+    Node* Optimizer::fold_binary(BinaryExprNode* node) {
+        std::string op = node->op.val;
+        int line = node->line;
+        double a, b;
+        bool p, q;
+        if (is_number(node->node_a, a) && is_number(node->node_b, b)) {
+            double result;
+            if (op == "+") {
+                result = a + b;
+            }
+            else if (op == "-") {
+                result = a - b;
+            }
+            else if (op == "*") {
+                result = a * b;
+            }
+            else if (op == "/") {
+                result = a / b;
+            }
+            else if (op == "%") {
+                result = std::fmod(a, b);
+            }
+            else if (op == "<" || op == "<=" || op == ">" || op == ">=" || op == "==" || op == "!=") {
+                bool test = op == "<" ? a < b : op == "<=" ? a <= b : op == ">" ? a > b : op == ">=" ? a >= b : op == "==" ? a == b : a != b;
+                return test ? (Node*)arena.make<TrueNode>(line) : (Node*)arena.make<FalseNode>(line);
+            }
+            else if (op == "<<" || op == ">>" || op == "&" || op == "|" || op == "^") {
+                int64_t x, y;
+                if (!is_integer(a, x) || !is_integer(b, y)) {
+                    return node;
+                }
+                // Shifts are only folded where C++ defines them
+                if (op == "<<" && x >= 0 && y >= 0 && y < 63 && x <= (INT64_MAX >> y)) {
+                    result = (double)(x << y);
+                }
+                else if (op == ">>" && x >= 0 && y >= 0 && y < 64) {
+                    result = (double)(x >> y);
+                }
+                else if (op == "&") {
+                    result = (double)(x & y);
+                }
+                else if (op == "|") {
+                    result = (double)(x | y);
+                }
+                else if (op == "^") {
+                    result = (double)(x ^ y);
+                }
+                else {
+                    return node;
+                }
+            }
+            else {
+                return node;
+            }
+            if (!std::isfinite(result)) {
+                return node;
+            }
+            return arena.make<NumberNode>(result, line);
+        }
+        if (is_bool(node->node_a, p) && is_bool(node->node_b, q)) {
+            bool test;
+            if (op == "&&") {
+                test = p && q;
+            }
+            else if (op == "||") {
+                test = p || q;
+            }
+            else if (op == "==") {
+                test = p == q;
+            }
+            else if (op == "!=") {
+                test = p != q;
+            }
+            else {
+                return node;
+            }
+            return test ? (Node*)arena.make<TrueNode>(line) : (Node*)arena.make<FalseNode>(line);
+        }
+        if ((op == "==" || op == "!=") && is_comparable(node->node_a) && is_comparable(node->node_b)) {
+            bool test = literals_equal(node->node_a, node->node_b) == (op == "==");
+            return test ? (Node*)arena.make<TrueNode>(line) : (Node*)arena.make<FalseNode>(line);
+        }
+        return node;
+    }
+
+    // What is left of a statement once branches that can't run are gone, or nullptr if nothing is
+    Node* Optimizer::prune(Node* node) {
+        bool test;
+        switch (node->kind()) {
+        case NodeKind::IF_STMT: {
+            IfStmtNode* if_stmt_node = static_cast<IfStmtNode*>(node);
+            if (is_bool(if_stmt_node->test, test)) {
+                return test ? prune(if_stmt_node->body) : nullptr;
+            }
+            return node;
+        }
+        case NodeKind::IF_ELSE_STMT: {
+            IfElseStmtNode* if_else_stmt_node = static_cast<IfElseStmtNode*>(node);
+            // The kept branch can itself be a statement with a literal test
+            if (is_bool(if_else_stmt_node->test, test)) {
+                return prune(test ? if_else_stmt_node->body : if_else_stmt_node->alternate);
+            }
+            return node;
+        }
+        case NodeKind::WHILE_STMT:
+            if (is_bool(static_cast<WhileStmtNode*>(node)->test, test) && !test) {
+                return nullptr;
+            }
+            return node;
+        default:
+            return node;
+        }
+    }
+
+    void Optimizer::eliminate(Node* node) {
+        if (node->kind() == NodeKind::STMT_LIST) {
+            std::vector<Node*> stmts;
+            for (Node* stmt : static_cast<StmtListNode*>(node)->stmts) {
+                if (Node* kept = prune(stmt)) {
+                    eliminate(kept);
+                    stmts.push_back(kept);
+                }
+            }
+            static_cast<StmtListNode*>(node)->stmts = stmts;
+            return;
+        }
+        for (Node** child : slots(node)) {
+            eliminate(*child);
+        }
+    }
+
+    // Counts the references to each var, following the scopes of the generated C++ as the Inferrer
+    // does. Parameters, defs and catch variables are in scope too, as nullptr, so that a var they
+    // shadow isn't counted as used.
+    void Optimizer::count_refs(Node* node, std::map<VarDeclStmtNode*, int>& refs) {
+        switch (node->kind()) {
+        case NodeKind::IDENTIFIER: {
+            const std::string& name = static_cast<IdentifierNode*>(node)->val;
+            for (std::size_t i = scopes.size(); i-- > 0;) {
+                std::map<std::string, VarDeclStmtNode*>::iterator it = scopes.at(i).find(name);
+                if (it != scopes.at(i).end()) {
+                    if (it->second) {
+                        refs[it->second]++;
+                    }
+                    break;
+                }
+            }
+            break;
+        }
+        case NodeKind::VAR_DECL_STMT: {
+            // As in C++, the variable is in scope in its own initializer
+            VarDeclStmtNode* var_decl_stmt_node = static_cast<VarDeclStmtNode*>(node);
+            scopes.back()[var_decl_stmt_node->name] = var_decl_stmt_node;
+            count_refs(var_decl_stmt_node->val, refs);
+            break;
+        }
+        case NodeKind::BLOCK_STMT:
+        case NodeKind::FOR_STMT:
+            scopes.push_back({});
+            for (Node** child : slots(node)) {
+                count_refs(*child, refs);
+            }
+            scopes.pop_back();
+            break;
+        case NodeKind::LAMBDA_EXPR: {
+            LambdaExprNode* lambda_expr_node = static_cast<LambdaExprNode*>(node);
+            scopes.push_back({});
+            for (const std::string& arg : lambda_expr_node->args) {
+                scopes.back()[arg] = nullptr;
+            }
+            count_refs(lambda_expr_node->body, refs);
+            scopes.pop_back();
+            break;
+        }
+        case NodeKind::FUNC_DECL_STMT: {
+            FuncDeclStmtNode* func_decl_stmt_node = static_cast<FuncDeclStmtNode*>(node);
+            scopes.back()[func_decl_stmt_node->name] = nullptr;
+            scopes.push_back({});
+            for (const std::string& arg : func_decl_stmt_node->args) {
+                scopes.back()[arg] = nullptr;
+            }
+            count_refs(func_decl_stmt_node->body, refs);
+            scopes.pop_back();
+            break;
+        }
+        case NodeKind::TRY_CATCH_STMT: {
+            TryCatchStmtNode* try_catch_stmt_node = static_cast<TryCatchStmtNode*>(node);
+            count_refs(try_catch_stmt_node->try_body, refs);
+            scopes.push_back({{try_catch_stmt_node->ex, nullptr}});
+            count_refs(try_catch_stmt_node->catch_body, refs);
+            scopes.pop_back();
+            break;
+        }
+        default:
+            for (Node** child : slots(node)) {
+                count_refs(*child, refs);
+            }
+        }
+    }
+
+    // A var is unused if no identifier refers to it, whatever other variables of the same name are used
+    bool Optimizer::remove_unused(Node* node, const std::map<VarDeclStmtNode*, int>& refs, bool root) {
+        bool removed = false;
+        if (node->kind() == NodeKind::STMT_LIST && !(module && root)) {
+            std::vector<Node*>& stmts = static_cast<StmtListNode*>(node)->stmts;
+            std::vector<Node*> kept;
+            for (Node* stmt : stmts) {
+                if (stmt->kind() == NodeKind::VAR_DECL_STMT) {
+                    VarDeclStmtNode* var_decl_stmt_node = static_cast<VarDeclStmtNode*>(stmt);
+                    if (!refs.count(var_decl_stmt_node) && is_pure(var_decl_stmt_node->val)) {
+                        removed = true;
+                        continue;
+                    }
+                }
+                kept.push_back(stmt);
+            }
+            stmts = kept;
+        }
+        for (Node** child : slots(node)) {
+            removed = remove_unused(*child, refs, false) || removed;
+        }
+        return removed;
+    }
+
+    Node* Optimizer::optimize(Node* node) {
+        for (const std::string& pass : passes) {
+            if (pass == "fold") {
+                node = fold(node);
+            }
+            else if (pass == "dce") {
+                eliminate(node);
+                // Removing a var can leave the vars its value referred to unused
+                std::map<VarDeclStmtNode*, int> refs;
+                do {
+                    refs.clear();
+                    scopes.push_back({});
+                    count_refs(node, refs);
+                    scopes.pop_back();
+                } while (remove_unused(node, refs, true));
+            }
+        }
+        return node;
+    }
+} // namespace tachyon
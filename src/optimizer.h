@@ -0,0 +1,37 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "node.h"
+
+namespace tachyon {
+    // Simplifies a tree after parsing and before the Inferrer, so the Transpiler never sees work
+    // that can be done at compile time. The passes run in the order given:
+    //   fold: operators on literals become literals, with the runtime's semantics
+    //   dce: if and while statements whose test is a literal lose the branches that can't run,
+    //        and vars that are never referenced go if their value has no effects
+    class Optimizer {
+    private:
+        std::vector<std::string> passes;
+        // Top-level vars of a module are its exports, so they are kept
+        bool module;
+        Arena& arena;
+        Node* fold(Node* node);
+        Node* fold_unary(UnaryExprNode* node);
+        Node* fold_binary(BinaryExprNode* node);
+        Node* prune(Node* node);
+        void eliminate(Node* node);
+        // What each name in scope refers to while counting references
+        std::vector<std::map<std::string, VarDeclStmtNode*> > scopes{};
+        void count_refs(Node* node, std::map<VarDeclStmtNode*, int>& refs);
+        bool remove_unused(Node* node, const std::map<VarDeclStmtNode*, int>& refs, bool root);
+    public:
+        static const std::vector<std::string> all_passes;
+        Optimizer(const std::vector<std::string>& passes, bool module, Arena& arena);
+        Node* optimize(Node* node);
+    };
+} // namespace tachyon
+
+#endif // OPTIMIZER_H
@@ -1,6 +1,5 @@
 #include <iostream>
 #include <string>
-#include <memory>
 #include <vector>
 #include <set>
 #include <functional>
@@ -13,13 +12,13 @@
 #include "parser.h"
 
 namespace tachyon {
-    Parser::Parser(const std::vector<Token>& tokens, const std::string& filename)
-        : tokens(tokens), pos(0), current(Token(TokenType::EOF_, "", 1)), filename(filename) {
+    Parser::Parser(const std::vector<Token>& tokens, const std::string& filename, Arena& arena)
+        : tokens(tokens), arena(arena), pos(0), current(Token(TokenType::EOF_, "", 1)), filename(filename) {
         advance();
     }
 
     void Parser::raise_error() const {
-        throw std::string(filename + ":" + std::to_string(current.line) + ": invalid syntax (unexpected '" + current.val + "')");
+        throw std::string(filename + ":" + std::to_string(current.line) + ": invalid syntax (unexpected '" + current.val.str() + "')");
     }
 
     void Parser::advance() {
@@ -39,20 +38,25 @@ namespace tachyon {
         }
     }
 
-    std::shared_ptr<Node> Parser::parse() {
+    Node* Parser::parse() {
         return stmt_list();
     }
 
-    std::shared_ptr<Node> Parser::stmt_list(TokenType end) {
+    // Import statements found by parse, in source order
+    const std::vector<ImportStmtNode*>& Parser::imports() const {
+        return import_nodes;
+    }
+
+    Node* Parser::stmt_list(TokenType end) {
         int line = current.line;
-        std::vector<std::shared_ptr<Node> > stmts;
+        std::vector<Node*> stmts;
         while (current.type != end) {
             stmts.push_back(stmt());
         }
-        return std::shared_ptr<StmtListNode>(new StmtListNode(stmts, line));
+        return arena.make<StmtListNode>(stmts, line);
     }
 
-    std::shared_ptr<Node> Parser::stmt() {
+    Node* Parser::stmt() {
         if (current.type == TokenType::VAR) {
             return var_decl_stmt();
         }
@@ -90,67 +94,58 @@ namespace tachyon {
     }
 
 
-    std::shared_ptr<Node> Parser::try_catch_stmt() {
+    Node* Parser::try_catch_stmt() {
         int line = current.line;
         eat(TokenType::TRY);
-        std::shared_ptr<Node> try_body = block_stmt();
+        Node* try_body = block_stmt();
         eat(TokenType::CATCH);
         eat(TokenType::LPAREN);
         std::string ex = eat(TokenType::IDENTIFIER).val;
         eat(TokenType::RPAREN);
-        std::shared_ptr<Node> catch_body = block_stmt();
-        return std::shared_ptr<TryCatchStmtNode>(new TryCatchStmtNode(try_body, ex, catch_body, line));    
+        Node* catch_body = block_stmt();
+        return arena.make<TryCatchStmtNode>(try_body, ex, catch_body, line);    
     }
 
-    std::shared_ptr<Node> Parser::cimport_stmt() {
+    Node* Parser::cimport_stmt() {
         int line = current.line;
         eat(TokenType::CIMPORT);
-        std::shared_ptr<Node> node = expr();
+        Node* node = expr();
         eat(TokenType::SEMICOLON);
         if (node->kind() == NodeKind::STRING) {
-            std::string path = static_cast<StringNode*>(node.get())->val;
-            return std::shared_ptr<Node>(new CImportStmtNode(path, line));
+            std::string path = static_cast<StringNode*>(node)->val;
+            return arena.make<CImportStmtNode>(path, line);
         }
         else {
             raise_error();
         }
     }
 
-    std::shared_ptr<Node> Parser::import_stmt() {
+    // The file is compiled separately, so only its path is recorded here
+    Node* Parser::import_stmt() {
         int line = current.line;
         eat(TokenType::IMPORT);
-        std::shared_ptr<Node> node = expr();
+        Node* node = expr();
         eat(TokenType::SEMICOLON);
         if (node->kind() == NodeKind::STRING) {
-            std::string in_filename = static_cast<StringNode*>(node.get())->val;
-            std::ifstream in_file;
-            in_file.open(in_filename);
-            
-            std::stringstream strStream;
-            strStream << in_file.rdbuf();
-
-            std::string text = strStream.str();
-            Lexer lexer(text, in_filename);
-            std::vector<Token> tokens = lexer.generate_tokens();
-            Parser parser(tokens, in_filename);
-            std::shared_ptr<tachyon::Node> tree = parser.parse();
-
-            return tree;
+            std::string path = static_cast<StringNode*>(node)->val;
+            ImportStmtNode* import_stmt_node = arena.make<ImportStmtNode>(path, line);
+            import_nodes.push_back(import_stmt_node);
+            return import_stmt_node;
         }
         else {
             raise_error();
         }
     }
 
-    std::shared_ptr<Node> Parser::return_stmt() {
+    Node* Parser::return_stmt() {
         int line = current.line;
         eat(TokenType::RETURN);
-        std::shared_ptr<Node> node = expr();
+        Node* node = expr();
         eat(TokenType::SEMICOLON);
-        return std::shared_ptr<ReturnStmtNode>(new ReturnStmtNode(node, line));
+        return arena.make<ReturnStmtNode>(node, line);
     }
 
-    std::shared_ptr<Node> Parser::func_decl_stmt() {
+    Node* Parser::func_decl_stmt() {
         int line = current.line;
         eat(TokenType::DEF);
         std::string name = eat(TokenType::IDENTIFIER).val;
@@ -166,159 +161,159 @@ namespace tachyon {
             }
         }
         eat(TokenType::RPAREN);
-        std::shared_ptr<Node> body = block_stmt();
-        return std::shared_ptr<FuncDeclStmtNode>(new FuncDeclStmtNode(name, args, body, line));
+        Node* body = block_stmt();
+        return arena.make<FuncDeclStmtNode>(name, args, body, line);
     }
 
-    std::shared_ptr<Node> Parser::for_stmt() {
+    Node* Parser::for_stmt() {
         int line = current.line;
         eat(TokenType::FOR);
         eat(TokenType::LPAREN);
-        std::shared_ptr<Node> init = var_decl_stmt();
-        std::shared_ptr<Node> test = expr();
+        Node* init = var_decl_stmt();
+        Node* test = expr();
         eat(TokenType::SEMICOLON);
-        std::shared_ptr<Node> update = expr();
+        Node* update = expr();
         eat(TokenType::RPAREN);
-        std::shared_ptr<Node> body = block_stmt();
-        return std::shared_ptr<ForStmtNode>(new ForStmtNode(init, test, update, body, line));
+        Node* body = block_stmt();
+        return arena.make<ForStmtNode>(init, test, update, body, line);
     }
 
-    std::shared_ptr<Node> Parser::while_stmt() {
+    Node* Parser::while_stmt() {
         int line = current.line;
         eat(TokenType::WHILE);
         eat(TokenType::LPAREN);
-        std::shared_ptr<Node> test = expr();
+        Node* test = expr();
         eat(TokenType::RPAREN);
-        std::shared_ptr<Node> body = block_stmt();
-        return std::shared_ptr<WhileStmtNode>(new WhileStmtNode(test, body, line));
+        Node* body = block_stmt();
+        return arena.make<WhileStmtNode>(test, body, line);
     }
 
-    std::shared_ptr<Node> Parser::if_stmt() {
+    Node* Parser::if_stmt() {
         int line = current.line;
         eat(TokenType::IF);
         eat(TokenType::LPAREN);
-        std::shared_ptr<Node> test = expr();
+        Node* test = expr();
         eat(TokenType::RPAREN);
-        std::shared_ptr<Node> body = block_stmt();
+        Node* body = block_stmt();
         if (current.type == TokenType::ELSE) {
             advance();
-            std::shared_ptr<Node> alternate = block_stmt();
-            return std::shared_ptr<IfElseStmtNode>(new IfElseStmtNode(test, body, alternate, line));
+            Node* alternate = block_stmt();
+            return arena.make<IfElseStmtNode>(test, body, alternate, line);
         }
-        return std::shared_ptr<IfStmtNode>(new IfStmtNode(test, body, line));
+        return arena.make<IfStmtNode>(test, body, line);
     }
 
-    std::shared_ptr<Node> Parser::block_stmt() {
+    Node* Parser::block_stmt() {
         int line = current.line;
         eat(TokenType::LCURLY);
-        std::shared_ptr<Node> node = stmt_list(TokenType::RCURLY);
+        Node* node = stmt_list(TokenType::RCURLY);
         eat(TokenType::RCURLY);
-        return std::shared_ptr<BlockStmtNode>(new BlockStmtNode(node, line));
+        return arena.make<BlockStmtNode>(node, line);
     }
 
-    std::shared_ptr<Node> Parser::var_decl_stmt() {
+    Node* Parser::var_decl_stmt() {
         int line = current.line;
         eat(TokenType::VAR);
         std::string name = eat(TokenType::IDENTIFIER).val;
         eat(TokenType::EQ);
-        std::shared_ptr<Node> val = expr();
+        Node* val = expr();
         eat(TokenType::SEMICOLON);
-        return std::shared_ptr<VarDeclStmtNode>(new VarDeclStmtNode(name, val, line));
+        return arena.make<VarDeclStmtNode>(name, val, line);
     }
 
-    std::shared_ptr<Node> Parser::expr_stmt() {
-        std::shared_ptr<Node> expr_node = expr();
+    Node* Parser::expr_stmt() {
+        Node* expr_node = expr();
         eat(TokenType::SEMICOLON);
-        return std::shared_ptr<ExprStmtNode>(new ExprStmtNode(expr_node, expr_node->line));
+        return arena.make<ExprStmtNode>(expr_node, expr_node->line);
     }
 
-    std::shared_ptr<Node> Parser::expr() {
+    Node* Parser::expr() {
         return assignment_expr();
     }
 
-    std::shared_ptr<Node> Parser::assignment_expr() {
-        std::shared_ptr<Node> node_a = or_expr();
+    Node* Parser::assignment_expr() {
+        Node* node_a = or_expr();
 
         if (current.type == TokenType::EQ) {
             Token op = current;
             advance();
-            std::shared_ptr<Node> node_b = expr();
-            node_a = std::shared_ptr<BinaryExprNode>(new BinaryExprNode(op, node_a, node_b, node_a->line));
+            Node* node_b = expr();
+            node_a = arena.make<BinaryExprNode>(op, node_a, node_b, node_a->line);
         }
 
         return node_a;
     }
 
-    std::shared_ptr<Node> Parser::binary_expr(const std::function<std::shared_ptr<Node>()>& operand, const std::set<TokenType>& op_types) {
-        std::shared_ptr<Node> node_a = operand();
+    Node* Parser::binary_expr(const std::function<Node*()>& operand, const std::set<TokenType>& op_types) {
+        Node* node_a = operand();
 
         while (std::find(op_types.begin(), op_types.end(), current.type) != op_types.end() && current.type != TokenType::EOF_) {
             Token op = current;
             advance();
-            std::shared_ptr<Node> node_b = operand();
-            node_a = std::shared_ptr<BinaryExprNode>(new BinaryExprNode(op, node_a, node_b, node_a->line));
+            Node* node_b = operand();
+            node_a = arena.make<BinaryExprNode>(op, node_a, node_b, node_a->line);
         }
 
         return node_a;
     }
 
-    std::shared_ptr<Node> Parser::or_expr() {
+    Node* Parser::or_expr() {
         return binary_expr([this]() { return and_expr(); }, { TokenType::OR });
     }
 
 
-    std::shared_ptr<Node> Parser::and_expr() {
+    Node* Parser::and_expr() {
         return binary_expr([this]() { return bitor_expr(); }, { TokenType::AND });
     }
 
-    std::shared_ptr<Node> Parser::bitor_expr() {
+    Node* Parser::bitor_expr() {
         return binary_expr([this]() { return bitxor_expr(); }, { TokenType::BITOR });
     }
 
-    std::shared_ptr<Node> Parser::bitxor_expr() {
+    Node* Parser::bitxor_expr() {
         return binary_expr([this]() { return bitand_expr(); }, { TokenType::BITXOR });
     }
 
-    std::shared_ptr<Node> Parser::bitand_expr() {
+    Node* Parser::bitand_expr() {
         return binary_expr([this]() { return equality_expr(); }, { TokenType::BITAND });
     }
 
-    std::shared_ptr<Node> Parser::equality_expr() {
+    Node* Parser::equality_expr() {
         return binary_expr([this]() { return comp_expr(); }, { TokenType::EE, TokenType::NE });
     }
 
-    std::shared_ptr<Node> Parser::comp_expr() {
+    Node* Parser::comp_expr() {
         return binary_expr([this]() { return shift_expr(); }, { TokenType::LT, TokenType::LE, TokenType::GT, TokenType::GE });
     }
 
-    std::shared_ptr<Node> Parser::shift_expr() {
+    Node* Parser::shift_expr() {
         return binary_expr([this]() { return additive_expr(); }, { TokenType::SL, TokenType::SR });
     }
 
-    std::shared_ptr<Node> Parser::additive_expr() {
+    Node* Parser::additive_expr() {
         return binary_expr([this]() { return multiplicative_expr(); }, { TokenType::PLUS, TokenType::MINUS });
     }
 
-    std::shared_ptr<Node> Parser::multiplicative_expr() {
+    Node* Parser::multiplicative_expr() {
         return binary_expr([this]() { return unary_expr(); }, { TokenType::MUL, TokenType::DIV, TokenType::MOD });
     }
 
-    std::shared_ptr<Node> Parser::unary_expr() {
+    Node* Parser::unary_expr() {
         Token op = current;
         if (op.type == TokenType::PLUS || op.type == TokenType::MINUS) {
             advance();
-            return std::shared_ptr<UnaryExprNode>(new UnaryExprNode(op, unary_expr(), op.line));
+            return arena.make<UnaryExprNode>(op, unary_expr(), op.line);
         }
         else {
             return call_attr_expr();
         }
     }
 
-    std::shared_ptr<Node> Parser::call_attr_expr() {
+    Node* Parser::call_attr_expr() {
         int line = current.line;
-        std::shared_ptr<Node> node = primary_expr();
+        Node* node = primary_expr();
         while (current.type == TokenType::LPAREN || current.type == TokenType::PERIOD) {
-            std::vector<std::shared_ptr<Node> > args;
+            std::vector<Node*> args;
             if (current.type == TokenType::LPAREN) {
                 advance();
                 while (current.type != TokenType::EOF_ && current.type != TokenType::RPAREN) {
@@ -332,12 +327,12 @@ namespace tachyon {
                 }
 
                 eat(TokenType::RPAREN);
-                return std::shared_ptr<CallExprNode>(new CallExprNode(node, args, line));
+                return arena.make<CallExprNode>(node, args, line);
             }
             else if (current.type == TokenType::PERIOD) {
                 advance();
                 std::string attr = eat(TokenType::IDENTIFIER).val;
-                node = std::shared_ptr<AttrExprNode>(new AttrExprNode(node, attr, line));
+                node = arena.make<AttrExprNode>(node, attr, line);
             }
 
         }
@@ -345,9 +340,9 @@ namespace tachyon {
         return node;
     }
 
-    std::shared_ptr<Node> Parser::vec_expr() {
+    Node* Parser::vec_expr() {
         int line = current.line;
-        std::vector<std::shared_ptr<Node> > elems;
+        std::vector<Node*> elems;
         eat(TokenType::LSQUARE);
         while (current.type != TokenType::EOF_ && current.type != TokenType::RSQUARE) {
             elems.push_back(expr());
@@ -359,13 +354,13 @@ namespace tachyon {
             }
         }
         eat(TokenType::RSQUARE);
-        return std::shared_ptr<VecNode>(new VecNode(elems, line));
+        return arena.make<VecNode>(elems, line);
     }
 
-    std::shared_ptr<Node> Parser::object_expr() {
+    Node* Parser::object_expr() {
         int line = current.line;
         std::vector<std::string> keys;
-        std::vector<std::shared_ptr<Node> > vals;
+        std::vector<Node*> vals;
         eat(TokenType::LCURLY);
         while (current.type != TokenType::EOF_ && current.type != TokenType::RCURLY) {
             keys.push_back(eat(TokenType::IDENTIFIER).val);
@@ -379,10 +374,10 @@ namespace tachyon {
             }
         }
         eat(TokenType::RCURLY);
-        return std::shared_ptr<ObjectNode>(new ObjectNode(keys, vals, line));
+        return arena.make<ObjectNode>(keys, vals, line);
     }
 
-    std::shared_ptr<Node> Parser::lambda_expr() {
+    Node* Parser::lambda_expr() {
         int line = current.line;
         eat(TokenType::LAMBDA);
         std::vector<std::string> args;
@@ -397,53 +392,53 @@ namespace tachyon {
             }
         }
         eat(TokenType::RPAREN);
-        std::shared_ptr<Node> body;
+        Node* body;
         if (current.type == TokenType::LCURLY) {
             body = block_stmt();
         }
         else {
             body = expr();
         }
-        return std::shared_ptr<LambdaExprNode>(new LambdaExprNode(args, body, line));
+        return arena.make<LambdaExprNode>(args, body, line);
     }
 
-    std::shared_ptr<Node> Parser::primary_expr() {
+    Node* Parser::primary_expr() {
         Token token = current;
 
         switch (token.type) {
         case TokenType::NIL: {
             advance();
-            return std::shared_ptr<NilNode>(new NilNode(token.line));
+            return arena.make<NilNode>(token.line);
         };
         case TokenType::NUMBER: {
             advance();
-            return std::shared_ptr<NumberNode>(new NumberNode(std::stod(token.val), token.line));
+            return arena.make<NumberNode>(std::stod(token.val), token.line);
         };
         case TokenType::TRUE: {
             advance();
-            return std::shared_ptr<TrueNode>(new TrueNode(token.line));
+            return arena.make<TrueNode>(token.line);
         };
         case TokenType::FALSE: {
             advance();
-            return std::shared_ptr<FalseNode>(new FalseNode(token.line));
+            return arena.make<FalseNode>(token.line);
         };
         case TokenType::CHAR: {
             advance();
-            return std::shared_ptr<CharNode>(new CharNode(token.val.at(1), token.line));
+            return arena.make<CharNode>(token.val.at(1), token.line);
         };
         case TokenType::STRING: {
             advance();
-            return std::shared_ptr<StringNode>(new StringNode(token.val, token.line));
+            return arena.make<StringNode>(token.val, token.line);
         };
         case TokenType::IDENTIFIER: {
             advance();
-            return std::shared_ptr<IdentifierNode>(new IdentifierNode(token.val, token.line));
+            return arena.make<IdentifierNode>(token.val, token.line);
         };
         case TokenType::LPAREN: {
             advance();
-            std::shared_ptr<Node> expr_node = expr();
+            Node* expr_node = expr();
             eat(TokenType::RPAREN);
-            return std::shared_ptr<ParenExprNode>(new ParenExprNode(expr_node, token.line));
+            return arena.make<ParenExprNode>(expr_node, token.line);
         };
         case TokenType::LAMBDA: {
             return lambda_expr();
@@ -0,0 +1,383 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "token.h"
+#include "node.h"
+#include "serializer.h"
+
+namespace tachyon {
+    // Changed whenever the layout of any node changes, so stale cache entries are never read
+    static const std::string magic = "TACHYON-AST 2\n";
+    // Stands for a missing child
+    static const unsigned char null_kind = 0xff;
+
+    // Unsigned LEB128, so small numbers like lines and lengths take one byte
+    void Serializer::write(uint32_t n) {
+        do {
+            unsigned char byte = n & 0x7f;
+            n >>= 7;
+            data += (char)(n ? byte | 0x80 : byte);
+        } while (n);
+    }
+
+    void Serializer::write(const std::string& s) {
+        write((uint32_t)s.size());
+        data += s;
+    }
+
+    void Serializer::write(const std::vector<std::string>& strings) {
+        write((uint32_t)strings.size());
+        for (const std::string& s : strings) {
+            write(s);
+        }
+    }
+
+    // Only operators are kept in the tree, and their text follows from their type
+    void Serializer::write(const Token& token) {
+        write((uint32_t)token.type);
+        write((uint32_t)token.line);
+    }
+
+    void Serializer::write(const std::vector<Node*>& nodes) {
+        write((uint32_t)nodes.size());
+        for (Node* node : nodes) {
+            write(node);
+        }
+    }
+
+    void Serializer::write(Node* node) {
+        if (!node) {
+            data += (char)null_kind;
+            return;
+        }
+        data += (char)node->kind();
+        write((uint32_t)node->line);
+        switch (node->kind()) {
+        case NodeKind::NUMBER: {
+            double val = static_cast<NumberNode*>(node)->val;
+            char bytes[sizeof(double)];
+            std::memcpy(bytes, &val, sizeof(double));
+            data.append(bytes, sizeof(double));
+            break;
+        }
+        case NodeKind::CHAR:
+            data += static_cast<CharNode*>(node)->val;
+            break;
+        case NodeKind::STRING:
+            write(static_cast<StringNode*>(node)->val);
+            break;
+        case NodeKind::IDENTIFIER:
+            write(static_cast<IdentifierNode*>(node)->val);
+            break;
+        case NodeKind::PAREN_EXPR:
+            write(static_cast<ParenExprNode*>(node)->node);
+            break;
+        case NodeKind::LAMBDA_EXPR:
+            write(static_cast<LambdaExprNode*>(node)->args);
+            write(static_cast<LambdaExprNode*>(node)->body);
+            break;
+        case NodeKind::OBJECT:
+            write(static_cast<ObjectNode*>(node)->keys);
+            write(static_cast<ObjectNode*>(node)->vals);
+            break;
+        case NodeKind::VEC:
+            write(static_cast<VecNode*>(node)->elems);
+            break;
+        case NodeKind::CALL_EXPR:
+            write(static_cast<CallExprNode*>(node)->callee);
+            write(static_cast<CallExprNode*>(node)->args);
+            break;
+        case NodeKind::ATTR_EXPR:
+            write(static_cast<AttrExprNode*>(node)->object);
+            write(static_cast<AttrExprNode*>(node)->attr);
+            break;
+        case NodeKind::UNARY_EXPR:
+            write(static_cast<UnaryExprNode*>(node)->op);
+            write(static_cast<UnaryExprNode*>(node)->node);
+            break;
+        case NodeKind::BINARY_EXPR:
+            write(static_cast<BinaryExprNode*>(node)->op);
+            write(static_cast<BinaryExprNode*>(node)->node_a);
+            write(static_cast<BinaryExprNode*>(node)->node_b);
+            break;
+        case NodeKind::EXPR_STMT:
+            write(static_cast<ExprStmtNode*>(node)->node);
+            break;
+        case NodeKind::VAR_DECL_STMT:
+            write(static_cast<VarDeclStmtNode*>(node)->name);
+            write(static_cast<VarDeclStmtNode*>(node)->val);
+            break;
+        case NodeKind::BLOCK_STMT:
+            write(static_cast<BlockStmtNode*>(node)->node);
+            break;
+        case NodeKind::IF_STMT:
+            write(static_cast<IfStmtNode*>(node)->test);
+            write(static_cast<IfStmtNode*>(node)->body);
+            break;
+        case NodeKind::IF_ELSE_STMT:
+            write(static_cast<IfElseStmtNode*>(node)->test);
+            write(static_cast<IfElseStmtNode*>(node)->body);
+            write(static_cast<IfElseStmtNode*>(node)->alternate);
+            break;
+        case NodeKind::WHILE_STMT:
+            write(static_cast<WhileStmtNode*>(node)->test);
+            write(static_cast<WhileStmtNode*>(node)->body);
+            break;
+        case NodeKind::FOR_STMT:
+            write(static_cast<ForStmtNode*>(node)->init);
+            write(static_cast<ForStmtNode*>(node)->test);
+            write(static_cast<ForStmtNode*>(node)->update);
+            write(static_cast<ForStmtNode*>(node)->body);
+            break;
+        case NodeKind::FUNC_DECL_STMT:
+            write(static_cast<FuncDeclStmtNode*>(node)->name);
+            write(static_cast<FuncDeclStmtNode*>(node)->args);
+            write(static_cast<FuncDeclStmtNode*>(node)->body);
+            break;
+        case NodeKind::RETURN_STMT:
+            write(static_cast<ReturnStmtNode*>(node)->node);
+            break;
+        case NodeKind::IMPORT_STMT:
+            write(static_cast<ImportStmtNode*>(node)->path);
+            break;
+        case NodeKind::CIMPORT_STMT:
+            write(static_cast<CImportStmtNode*>(node)->path);
+            break;
+        case NodeKind::TRY_CATCH_STMT:
+            write(static_cast<TryCatchStmtNode*>(node)->try_body);
+            write(static_cast<TryCatchStmtNode*>(node)->ex);
+            write(static_cast<TryCatchStmtNode*>(node)->catch_body);
+            break;
+        case NodeKind::STMT_LIST:
+            write(static_cast<StmtListNode*>(node)->stmts);
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::string Serializer::serialize(Node* node) {
+        data = magic;
+        write(node);
+        return data;
+    }
+
+    Deserializer::Deserializer(const std::string& data, const std::string& filename, Arena& arena)
+        : data(data), arena(arena), pos(0), filename(filename) {
+    }
+
+    void Deserializer::raise_error() const {
+        throw std::string(filename + ": corrupt cached syntax tree");
+    }
+
+    uint32_t Deserializer::read_uint() {
+        uint32_t n = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (pos >= data.size()) {
+                raise_error();
+            }
+            unsigned char byte = data[pos++];
+            n |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return n;
+            }
+        }
+        raise_error();
+    }
+
+    std::string Deserializer::read_string() {
+        uint32_t size = read_uint();
+        if (size > data.size() - pos) {
+            raise_error();
+        }
+        std::string s = data.substr(pos, size);
+        pos += size;
+        return s;
+    }
+
+    // Every element takes at least one byte, so a count larger than what is left is damage, and
+    // checking it first keeps a bad entry from allocating billions of elements
+    std::size_t Deserializer::read_count() {
+        uint32_t count = read_uint();
+        if (count > data.size() - pos) {
+            raise_error();
+        }
+        return count;
+    }
+
+    std::vector<std::string> Deserializer::read_strings() {
+        std::vector<std::string> strings(read_count());
+        for (std::string& s : strings) {
+            s = read_string();
+        }
+        return strings;
+    }
+
+    Token Deserializer::read_token() {
+        TokenType type = (TokenType)read_uint();
+        StringView val = spelling(type);
+        if (val.size == 0) {
+            raise_error();
+        }
+        return Token(type, val, read_uint());
+    }
+
+    std::vector<Node*> Deserializer::read_nodes() {
+        std::vector<Node*> nodes(read_count());
+        for (Node*& node : nodes) {
+            node = read_node();
+        }
+        return nodes;
+    }
+
+    // Arguments are read into locals first, since their order of evaluation in a call is unspecified.
+    // The parser never leaves a child out, so a missing one is damage too, which is caught here
+    // rather than when the Inferrer follows it.
+    Node* Deserializer::read_node() {
+        if (pos >= data.size()) {
+            raise_error();
+        }
+        unsigned char kind = data[pos++];
+        if (kind == null_kind) {
+            raise_error();
+        }
+        int line = read_uint();
+        switch ((NodeKind)kind) {
+        case NodeKind::NIL:
+            return arena.make<NilNode>(line);
+        case NodeKind::NUMBER: {
+            if (data.size() - pos < sizeof(double)) {
+                raise_error();
+            }
+            double val;
+            std::memcpy(&val, data.data() + pos, sizeof(double));
+            pos += sizeof(double);
+            return arena.make<NumberNode>(val, line);
+        }
+        case NodeKind::TRUE:
+            return arena.make<TrueNode>(line);
+        case NodeKind::FALSE:
+            return arena.make<FalseNode>(line);
+        case NodeKind::CHAR: {
+            if (pos >= data.size()) {
+                raise_error();
+            }
+            char val = data[pos++];
+            return arena.make<CharNode>(val, line);
+        }
+        case NodeKind::STRING:
+            return arena.make<StringNode>(read_string(), line);
+        case NodeKind::IDENTIFIER:
+            return arena.make<IdentifierNode>(read_string(), line);
+        case NodeKind::PAREN_EXPR:
+            return arena.make<ParenExprNode>(read_node(), line);
+        case NodeKind::LAMBDA_EXPR: {
+            std::vector<std::string> args = read_strings();
+            Node* body = read_node();
+            return arena.make<LambdaExprNode>(args, body, line);
+        }
+        case NodeKind::OBJECT: {
+            std::vector<std::string> keys = read_strings();
+            std::vector<Node*> vals = read_nodes();
+            return arena.make<ObjectNode>(keys, vals, line);
+        }
+        case NodeKind::VEC:
+            return arena.make<VecNode>(read_nodes(), line);
+        case NodeKind::CALL_EXPR: {
+            Node* callee = read_node();
+            std::vector<Node*> args = read_nodes();
+            return arena.make<CallExprNode>(callee, args, line);
+        }
+        case NodeKind::ATTR_EXPR: {
+            Node* object = read_node();
+            std::string attr = read_string();
+            return arena.make<AttrExprNode>(object, attr, line);
+        }
+        case NodeKind::UNARY_EXPR: {
+            Token op = read_token();
+            Node* node = read_node();
+            return arena.make<UnaryExprNode>(op, node, line);
+        }
+        case NodeKind::BINARY_EXPR: {
+            Token op = read_token();
+            Node* node_a = read_node();
+            Node* node_b = read_node();
+            return arena.make<BinaryExprNode>(op, node_a, node_b, line);
+        }
+        case NodeKind::EXPR_STMT:
+            return arena.make<ExprStmtNode>(read_node(), line);
+        case NodeKind::VAR_DECL_STMT: {
+            std::string name = read_string();
+            Node* val = read_node();
+            return arena.make<VarDeclStmtNode>(name, val, line);
+        }
+        case NodeKind::BLOCK_STMT:
+            return arena.make<BlockStmtNode>(read_node(), line);
+        case NodeKind::IF_STMT: {
+            Node* test = read_node();
+            Node* body = read_node();
+            return arena.make<IfStmtNode>(test, body, line);
+        }
+        case NodeKind::IF_ELSE_STMT: {
+            Node* test = read_node();
+            Node* body = read_node();
+            Node* alternate = read_node();
+            return arena.make<IfElseStmtNode>(test, body, alternate, line);
+        }
+        case NodeKind::WHILE_STMT: {
+            Node* test = read_node();
+            Node* body = read_node();
+            return arena.make<WhileStmtNode>(test, body, line);
+        }
+        case NodeKind::FOR_STMT: {
+            Node* init = read_node();
+            Node* test = read_node();
+            Node* update = read_node();
+            Node* body = read_node();
+            return arena.make<ForStmtNode>(init, test, update, body, line);
+        }
+        case NodeKind::FUNC_DECL_STMT: {
+            std::string name = read_string();
+            std::vector<std::string> args = read_strings();
+            Node* body = read_node();
+            return arena.make<FuncDeclStmtNode>(name, args, body, line);
+        }
+        case NodeKind::RETURN_STMT:
+            return arena.make<ReturnStmtNode>(read_node(), line);
+        case NodeKind::IMPORT_STMT: {
+            ImportStmtNode* import_stmt_node = arena.make<ImportStmtNode>(read_string(), line);
+            import_nodes.push_back(import_stmt_node);
+            return import_stmt_node;
+        }
+        case NodeKind::CIMPORT_STMT:
+            return arena.make<CImportStmtNode>(read_string(), line);
+        case NodeKind::TRY_CATCH_STMT: {
+            Node* try_body = read_node();
+            std::string ex = read_string();
+            Node* catch_body = read_node();
+            return arena.make<TryCatchStmtNode>(try_body, ex, catch_body, line);
+        }
+        case NodeKind::STMT_LIST:
+            return arena.make<StmtListNode>(read_nodes(), line);
+        default:
+            raise_error();
+        }
+    }
+
+    Node* Deserializer::deserialize() {
+        if (data.compare(0, magic.size(), magic) != 0) {
+            raise_error();
+        }
+        pos = magic.size();
+        Node* node = read_node();
+        if (pos != data.size()) {
+            raise_error();
+        }
+        return node;
+    }
+
+    const std::vector<ImportStmtNode*>& Deserializer::imports() const {
+        return import_nodes;
+    }
+} // namespace tachyon
\ No newline at end of file
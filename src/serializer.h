@@ -0,0 +1,51 @@
+#ifndef SERIALIZER_H
+#define SERIALIZER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "token.h"
+#include "node.h"
+
+namespace tachyon {
+    // Writes a tree straight from the Parser in a compact binary form, so large modules that
+    // haven't changed can be loaded from the build cache instead of being lexed and parsed again.
+    // Fields the Inferrer fills in are not saved.
+    class Serializer {
+    private:
+        std::string data{};
+        void write(uint32_t n);
+        void write(const std::string& s);
+        void write(const std::vector<std::string>& strings);
+        void write(const Token& token);
+        void write(Node* node);
+        void write(const std::vector<Node*>& nodes);
+    public:
+        std::string serialize(Node* node);
+    };
+
+    // Rebuilds a tree written by Serializer, collecting its import statements as the Parser does.
+    // Data from another format version, or cut short, is rejected with an exception.
+    class Deserializer {
+    private:
+        const std::string& data;
+        Arena& arena;
+        std::size_t pos;
+        std::string filename{};
+        std::vector<ImportStmtNode*> import_nodes{};
+        [[noreturn]] void raise_error() const;
+        uint32_t read_uint();
+        std::string read_string();
+        std::size_t read_count();
+        std::vector<std::string> read_strings();
+        Token read_token();
+        Node* read_node();
+        std::vector<Node*> read_nodes();
+    public:
+        Deserializer(const std::string& data, const std::string& filename, Arena& arena);
+        Node* deserialize();
+        const std::vector<ImportStmtNode*>& imports() const;
+    };
+} // namespace tachyon
+
+#endif // SERIALIZER_H
\ No newline at end of file
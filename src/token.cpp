@@ -1,10 +1,35 @@
 
 #include <string>
+#include <cstring>
+#include <stdexcept>
 #include "token.h"
 
 namespace tachyon {
-    Token::Token(TokenType type, const std::string& val, int line)
-        : type(type), val(val), line(line) {
+    char StringView::at(std::size_t i) const {
+        if (i >= size) {
+            throw std::out_of_range("StringView::at");
+        }
+        return data[i];
+    }
+
+    std::string StringView::str() const {
+        return std::string(data, size);
+    }
+
+    StringView::operator std::string() const {
+        return str();
+    }
+
+    bool StringView::operator==(const char* s) const {
+        return std::strncmp(data, s, size) == 0 && s[size] == '\0';
+    }
+
+    bool StringView::operator!=(const char* s) const {
+        return !(*this == s);
+    }
+
+    Token::Token(TokenType type, StringView val, int line)
+        : type(type), line(line), val(val) {
     }
 
     std::string Token::str() const {
@@ -24,6 +49,7 @@ namespace tachyon {
             break;
         case TokenType::NIL:
             result += "NIL";
+            break;
         case TokenType::TRUE:
             result += "TRUE";
             break;
@@ -161,8 +187,108 @@ namespace tachyon {
             break;
         }
         result += ':';
-        result += val;
+        result += val.str();
         return result;
     }
 
+    // How the Lexer spells a keyword or operator, or an empty view for tokens that vary
+    StringView spelling(TokenType type) {
+        switch (type) {
+        case TokenType::NIL:
+            return "nil";
+        case TokenType::TRUE:
+            return "true";
+        case TokenType::FALSE:
+            return "false";
+        case TokenType::VAR:
+            return "var";
+        case TokenType::BLOCK:
+            return "block";
+        case TokenType::IF:
+            return "if";
+        case TokenType::ELSE:
+            return "else";
+        case TokenType::WHILE:
+            return "while";
+        case TokenType::FOR:
+            return "for";
+        case TokenType::DEF:
+            return "def";
+        case TokenType::LAMBDA:
+            return "lambda";
+        case TokenType::RETURN:
+            return "return";
+        case TokenType::IMPORT:
+            return "import";
+        case TokenType::CIMPORT:
+            return "cimport";
+        case TokenType::TRY:
+            return "try";
+        case TokenType::CATCH:
+            return "catch";
+        case TokenType::PLUS:
+            return "+";
+        case TokenType::MINUS:
+            return "-";
+        case TokenType::MUL:
+            return "*";
+        case TokenType::DIV:
+            return "/";
+        case TokenType::MOD:
+            return "%";
+        case TokenType::SL:
+            return ">>";
+        case TokenType::SR:
+            return "<<";
+        case TokenType::BITAND:
+            return "&";
+        case TokenType::BITOR:
+            return "|";
+        case TokenType::BITXOR:
+            return "^";
+        case TokenType::AND:
+            return "&&";
+        case TokenType::OR:
+            return "||";
+        case TokenType::EQ:
+            return "=";
+        case TokenType::EE:
+            return "==";
+        case TokenType::NE:
+            return "!=";
+        case TokenType::LT:
+            return "<";
+        case TokenType::LE:
+            return "<=";
+        case TokenType::GT:
+            return ">";
+        case TokenType::GE:
+            return ">=";
+        case TokenType::LPAREN:
+            return "(";
+        case TokenType::RPAREN:
+            return ")";
+        case TokenType::LCURLY:
+            return "{";
+        case TokenType::RCURLY:
+            return "}";
+        case TokenType::LSQUARE:
+            return "[";
+        case TokenType::RSQUARE:
+            return "]";
+        case TokenType::COMMA:
+            return ",";
+        case TokenType::COLON:
+            return ":";
+        case TokenType::SEMICOLON:
+            return ";";
+        case TokenType::PERIOD:
+            return ".";
+        case TokenType::EOF_:
+            return "<eof>";
+        default:
+            return StringView();
+        }
+    }
+
 } // namespace tachyon
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define TOKEN_H
 
 #include <string>
+#include <cstddef>
+#include <cstring>
 
 namespace tachyon {
     enum class TokenType {
@@ -57,14 +59,34 @@ namespace tachyon {
         EOF_
     };
     
+    // Characters of a source buffer or a string literal, which must outlive the view. Stands in
+    // for std::string_view, which needs C++17.
+    class StringView {
+    public:
+        const char* data;
+        std::size_t size;
+        StringView() : data(""), size(0) {}
+        StringView(const char* s) : data(s), size(std::strlen(s)) {}
+        StringView(const char* data, std::size_t size) : data(data), size(size) {}
+        char at(std::size_t i) const;
+        std::string str() const;
+        operator std::string() const;
+        bool operator==(const char* s) const;
+        bool operator!=(const char* s) const;
+    };
+
+    // Tokens refer to the source instead of copying it, so the text given to the Lexer has to
+    // outlive them. Operators and keywords refer to string literals, so nodes can keep them.
     class Token {
     public:
         TokenType type;
-        std::string val{};
         int line;
-        Token(TokenType type, const std::string& val, int line);
+        StringView val;
+        Token(TokenType type, StringView val, int line);
         std::string str() const;  
     };
+
+    StringView spelling(TokenType type);
 } // namespace tachyon
 
 #endif // TOKEN_H
\ No newline at end of file
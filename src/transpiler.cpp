@@ -1,612 +1,17 @@
 #include <iostream>
+#include <iomanip>
 #include <string>
 #include <sstream>
 #include <set>
+#include <algorithm>
+#include <cstdlib>
 #include "node.h"
 #include "transpiler.h"
+#include "module.h"
 
 namespace tachyon {
-    const std::string Transpiler::boilerplate = R"VOG0N(
-class TachyonObject;
-
-// Tagged union
-class TachyonVal {
-public:
-    enum {
-        NIL,
-        NUM,
-        BOOL,
-        CHAR,
-        OBJECT
-    } tag;
-
-    union {
-        double n;
-        bool b;
-        char c;
-        TachyonObject* o;
-    };
-
-    TachyonVal() = default;
-
-    static TachyonVal make_nil();
-    static TachyonVal make_num(double n);
-    static TachyonVal make_bool(bool b);
-    static TachyonVal make_char(char c);
-    static TachyonVal make_object(const std::map<std::string, TachyonVal>& map);
-    static TachyonVal make_str(const std::string& s);
-    static TachyonVal make_vec(const std::vector<TachyonVal>& v);
-    static TachyonVal make_func(const std::function<TachyonVal(std::vector<TachyonVal>)>& f);
-    static TachyonVal make_thread(std::thread* t);
-    TachyonVal operator+() const;
-    TachyonVal operator-() const;
-    TachyonVal operator+(const TachyonVal& other) const;
-    TachyonVal operator-(const TachyonVal& other) const;
-    TachyonVal operator*(const TachyonVal& other) const;
-    TachyonVal operator/(const TachyonVal& other) const;
-    TachyonVal operator%(const TachyonVal& other) const;
-    TachyonVal operator<<(const TachyonVal& other) const;
-    TachyonVal operator>>(const TachyonVal& other) const;
-    TachyonVal operator&(const TachyonVal& other) const;
-    TachyonVal operator|(const TachyonVal& other) const;
-    TachyonVal operator^(const TachyonVal& other) const;
-    TachyonVal operator&&(const TachyonVal& other) const;
-    TachyonVal operator||(const TachyonVal& other) const;
-    TachyonVal operator<(const TachyonVal& other) const;
-    TachyonVal operator<=(const TachyonVal& other) const;
-    TachyonVal operator>(const TachyonVal& other) const;
-    TachyonVal operator>=(const TachyonVal& other) const;
-    TachyonVal operator==(const TachyonVal& other) const;
-    TachyonVal operator!=(const TachyonVal& other) const;
-    TachyonVal operator()(const std::vector<TachyonVal>& args);
-    std::string str() const;
-};
-
-extern TachyonVal String;
-extern TachyonVal Vec;
-extern TachyonVal Func;
-extern TachyonVal Thread;
-
-class TachyonObject {
-public:
-    std::map<std::string, TachyonVal> map{};
-    TachyonObject() = default;
-    TachyonObject(const std::map<std::string, TachyonVal>& map);
-    TachyonVal get(const std::string& key) const;
-    TachyonVal set(const std::string& key, const TachyonVal& val);
-};
-
-
-class TachyonString: public TachyonObject {
-public:
-    std::string s;
-    TachyonString(const std::string& s);
-};
-
-class TachyonVec: public TachyonObject {
-public:
-    std::vector<TachyonVal> v;
-    TachyonVec(const std::vector<TachyonVal>& v);
-};
-
-class TachyonFunc: public TachyonObject {
-public:
-    std::function<TachyonVal(std::vector<TachyonVal>)> f;
-    TachyonFunc(const std::function<TachyonVal(std::vector<TachyonVal>)>& f);
-};
-
-class TachyonThread: public TachyonObject {
-public:
-    std::thread* t;
-    TachyonThread(std::thread* t);
-};
-
-TachyonVal TachyonVal::make_nil() {
-    TachyonVal result;
-    result.tag = NIL;
-    return result;
-}
-
-TachyonVal TachyonVal::make_num(double n) {
-    TachyonVal result;
-    result.tag = NUM;
-    result.n = n;
-    return result;
-}
-
-TachyonVal TachyonVal::make_bool(bool b) {
-    TachyonVal result;
-    result.tag = BOOL;
-    result.b = b;
-    return result;
-}
-
-TachyonVal TachyonVal::make_char(char c) {
-    TachyonVal result;
-    result.tag = CHAR;
-    result.c = c;
-    return result;
-}
-
-TachyonVal TachyonVal::make_object(const std::map<std::string, TachyonVal>& map) {
-    TachyonVal result;
-    result.tag = TachyonVal::OBJECT;
-    result.o = new TachyonObject(map);
-    return result;
-}
-
-TachyonVal TachyonVal::make_str(const std::string& s) {
-    TachyonVal result;
-    result.tag = OBJECT;
-    result.o = new TachyonString(s);
-    return result;
-}
-
-TachyonVal TachyonVal::make_thread(std::thread* t) {
-    TachyonVal result;
-    result.tag = OBJECT;
-    result.o = new TachyonThread(t);
-    return result;
-}
-
-TachyonVal TachyonVal::make_vec(const std::vector<TachyonVal>& v) {
-    TachyonVal result;
-    result.tag = TachyonVal::OBJECT;
-    result.o = new TachyonVec(v);
-    return result;
-}
-
-TachyonVal TachyonVal::make_func(const std::function<TachyonVal(std::vector<TachyonVal>)>& f) {
-    TachyonVal result;
-    result.tag = TachyonVal::OBJECT;
-    result.o = new TachyonFunc(f);
-    return result;
-}
-
-TachyonVal TachyonVal::operator+() const {
-    assert(tag == NUM);
-    return TachyonVal::make_num(+n);
-}
-
-TachyonVal TachyonVal::operator-() const {
-    assert(tag == NUM);
-    return TachyonVal::make_num(-n);
-}
-
-TachyonVal TachyonVal::operator+(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num(n + other.n);
-}
-
-TachyonVal TachyonVal::operator-(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num(n - other.n);
-}
-
-TachyonVal TachyonVal::operator*(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num(n * other.n);
-}
-
-TachyonVal TachyonVal::operator/(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num(n / other.n);
-}
-
-TachyonVal TachyonVal::operator%(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num(std::fmod(n, other.n));
-}
-
-TachyonVal TachyonVal::operator<<(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num((int64_t)n << (int64_t)other.n);
-}
-
-TachyonVal TachyonVal::operator>>(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num((int64_t)n >> (int64_t)other.n);
-}
-
-TachyonVal TachyonVal::operator&(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num((int64_t)n && (int64_t)other.n);
-}
-
-TachyonVal TachyonVal::operator|(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num((int64_t)n | (int64_t)other.n);
-}
-
-TachyonVal TachyonVal::operator^(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_num((int64_t)n ^ (int64_t)other.n);
-}
-
-TachyonVal TachyonVal::operator&&(const TachyonVal& other) const {
-    assert(tag == BOOL && other.tag == BOOL);
-    return TachyonVal::make_bool(n && other.n);
-}
-
-TachyonVal TachyonVal::operator||(const TachyonVal& other) const {
-    assert(tag == BOOL && other.tag == BOOL);
-    return TachyonVal::make_bool(n || other.n);
-}
-
-TachyonVal TachyonVal::operator<(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_bool(n < other.n);
-}
-
-TachyonVal TachyonVal::operator<=(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_bool(n <= other.n);
-}
-
-TachyonVal TachyonVal::operator>(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_bool(n > other.n);
-}
-
-TachyonVal TachyonVal::operator>=(const TachyonVal& other) const {
-    assert(tag == NUM && other.tag == NUM);
-    return TachyonVal::make_bool(n >= other.n);
-}
-
-TachyonVal TachyonVal::operator==(const TachyonVal& other) const {
-    if (tag == NIL) {
-        return TachyonVal::make_bool(other.tag == NIL);
-    }
-    else if (tag == NUM) {
-        return TachyonVal::make_bool(other.tag == NUM && n == other.n);
-    }
-    else if (tag == BOOL) {
-        return TachyonVal::make_bool(other.tag == BOOL && b == other.b);
-    }
-    else if (tag == OBJECT) {
-        return TachyonVal::make_bool(other.tag == OBJECT && o == other.o);
-    }
-    return TachyonVal::make_nil();
-}
-
-TachyonVal TachyonVal::operator!=(const TachyonVal& other) const {
-    return TachyonVal::make_bool(!(operator==(other)).b);
-}
-
-TachyonVal TachyonVal::operator()(const std::vector<TachyonVal>& args) {
-    assert(tag == OBJECT);
-    return static_cast<TachyonFunc*>(o)->f(args);
-}
-
-std::string TachyonVal::str() const {
-    if (tag == NIL) {
-        return "nil";
-    }
-    else if (tag == NUM) {
-        std::ostringstream oss;
-        oss << n;
-        return oss.str();
-    }
-    else if (tag == BOOL) {
-        return b ? "true" : "false";
-    }
-    else if (tag == CHAR) {
-        return std::string(1, c);
-    }
-    else if (tag == OBJECT) {
-        if ((o->map.at("proto") == String).b) {
-            return static_cast<TachyonString*>(o)->s;
-        }
-        std::ostringstream oss;
-        oss << o;
-        return oss.str();
-    }
-    return "";
-}
-
-TachyonObject::TachyonObject(const std::map<std::string, TachyonVal>& map)
-    : map(map) {
-}
-
-TachyonVal TachyonObject::get(const std::string& key) const {
-    if (!(map.count(key)) && map.count("proto")) {
-        return map.at("proto").o->get(key);
-    }
-    else {
-        return map.at(key);
-    }
-}
-
-TachyonVal TachyonObject::set(const std::string& key, const TachyonVal& val) {
-    map[key] = val;
-    return val;
-}
-
-TachyonString::TachyonString(const std::string& s)
-    : s(s) {
-    set("proto", String);
-}
-
-TachyonVec::TachyonVec(const std::vector<TachyonVal>& v)
-    : v(v) {
-    set("proto", Vec);
-}
-
-TachyonFunc::TachyonFunc(const std::function<TachyonVal(std::vector<TachyonVal>)>& f)
-    : f(f) {
-    set("proto", Func);
-}
-
-TachyonThread::TachyonThread(std::thread* t)
-    : t(t) {
-    set("proto", Thread);
-}
-
-std::random_device rd;
-std::mt19937 mt(rd());
-std::uniform_real_distribution<double> dist(0.0, 1.0);
-
-TachyonVal System = TachyonVal::make_object({
-    {"print", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        std::cout << args.at(1).str() << '\n';
-        return TachyonVal::make_nil();
-    })},
-    {"input", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        std::string input;
-        std::cin >> input;
-        return TachyonVal::make_str(input);
-    })},
-    {"exit", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        std::exit(0);
-        return TachyonVal::make_nil();
-    })},
-    {"time", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        return TachyonVal::make_num(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
-    })},
-    {"assert", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::BOOL && args.at(1).b);
-        return TachyonVal::make_nil();
-
-    })},
-    });
-
-TachyonVal Math = TachyonVal::make_object({
-    {"PI", TachyonVal::make_num(3.14159265358979323846)},
-    {"E", TachyonVal::make_num(2.7182818284590452354)},
-    {"sin", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::sin(args.at(1).n));
-    })},
-    {"cos", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::cos(args.at(1).n));
-    })},
-    {"tan", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::tan(args.at(1).n));
-    })},
-    {"asin", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::asin(args.at(1).n));
-    })},
-    {"acos", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::acos(args.at(1).n));
-    })},
-    {"atan", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::atan(args.at(1).n));
-    })},
-    {"atan2", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM && args.at(2).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::atan2(args.at(1).n, args.at(2).n));
-    })},
-    {"exp", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::exp(args.at(1).n));
-    })},
-    {"log", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::log(args.at(1).n));
-    })},
-    {"sqrt", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::sqrt(args.at(1).n));
-    })},
-    {"pow", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM && args.at(2).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::pow(args.at(1).n, args.at(2).n));
-    })},
-    {"ceil", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::ceil(args.at(1).n));
-    })},
-    {"floor", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::floor(args.at(1).n));
-    })},
-    {"round", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(1).tag == TachyonVal::NUM);
-        return TachyonVal::make_num(std::round(args.at(1).n));
-    })},
-    {"rand", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        return TachyonVal::make_num(dist(mt));
-    })}
-    });
-
-TachyonVal String = TachyonVal::make_object({
-    {"length", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        return TachyonVal::make_num(str.length());
-    })},
-    {"at", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT && args.at(1).tag == TachyonVal::NUM);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        return TachyonVal::make_char(str.at(args.at(1).n));
-    })},
-    {"first", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        return TachyonVal::make_char(str.front());
-    })},
-    {"last", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        return TachyonVal::make_char(str.back());
-    })},
-    {"find", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT && args.at(1).tag == TachyonVal::OBJECT);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        std::string str2 = static_cast<TachyonString*>(args.at(1).o)->s;
-        return TachyonVal::make_num(str.find(str2));
-    })},
-    {"contains", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT && args.at(1).tag == TachyonVal::OBJECT);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        std::string str2 = static_cast<TachyonString*>(args.at(1).o)->s;
-        return TachyonVal::make_bool(str.find(str2) != std::string::npos);
-    })},
-    {"substr", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT && args.at(1).tag == TachyonVal::NUM && args.at(2).tag == TachyonVal::NUM);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        return TachyonVal::make_str(str.substr(args.at(1).n, args.at(2).n));
-    })},
-    {"concat", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT && args.at(1).tag == TachyonVal::OBJECT);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        std::string str2 = static_cast<TachyonString*>(args.at(1).o)->s;
-        return TachyonVal::make_str(str + str2);
-    })},
-    {"split", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT);
-        std::string str = static_cast<TachyonString*>(args.at(0).o)->s;
-        std::string str2 = static_cast<TachyonString*>(args.at(1).o)->s;
-        std::string str3 = str;
-        std::vector<TachyonVal> list;
-        std::size_t pos = 0;
-        std::string token;
-        while ((pos = str3.find(str2)) != std::string::npos) {
-            token = str3.substr(0, pos);
-            list.push_back(TachyonVal::make_str(token));
-            str3.erase(0, pos + str2.length());
-        }
-        list.push_back(TachyonVal::make_str(str3));
-        return TachyonVal::make_vec(list);
-    })},
-    {"from", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        return TachyonVal::make_str(args.at(1).str());
-    })}
-    });
-
-TachyonVal Vec = TachyonVal::make_object({
-    {"length", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT);
-        std::vector<TachyonVal> vec = static_cast<TachyonVec*>(args.at(0).o)->v;
-        return TachyonVal::make_num(vec.size());
-    })},
-    {"at", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT);
-        assert(args.at(1).tag == TachyonVal::NUM);
-        std::vector<TachyonVal> vec = static_cast<TachyonVec*>(args.at(0).o)->v;
-        return vec.at(args.at(1).n);
-    })},
-    {"first", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT);
-        std::vector<TachyonVal> vec = static_cast<TachyonVec*>(args.at(0).o)->v;
-        return vec.front();
-    })},
-    {"last", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-        assert(args.at(0).tag == TachyonVal::OBJECT);
-        std::vector<TachyonVal> vec = static_cast<TachyonVec*>(args.at(0).o)->v;
-        return vec.back();
-    })},
-    {"push", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-    assert(args.at(0).tag == TachyonVal::OBJECT);
-    std::vector<TachyonVal> vec = static_cast<TachyonVec*>(args.at(0).o)->v;
-    vec.push_back(args.at(1));
-    return TachyonVal::make_nil();
-    })},
-    {"pop", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-    assert(args.at(0).tag == TachyonVal::OBJECT);
-    std::vector<TachyonVal> vec = static_cast<TachyonVec*>(args.at(0).o)->v;
-    vec.pop_back();
-    return TachyonVal::make_nil();
-    })},
-    {"subvec", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-    assert(args.at(0).tag == TachyonVal::OBJECT && args.at(1).tag == TachyonVal::NUM && args.at(2).tag == TachyonVal::NUM);
-    std::vector<TachyonVal> vec = static_cast<TachyonVec*>(args.at(0).o)->v;
-    return TachyonVal::make_vec({vec.begin() + args.at(1).n, vec.begin() + args.at(1).n + args.at(2).n});
-    })}
-    });
-
-TachyonVal Func = TachyonVal::make_object({});
-
-TachyonVal Thread = TachyonVal::make_object({
-    {"create", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-    assert(args.at(1).tag == TachyonVal::OBJECT);
-
-    return TachyonVal::make_thread(new std::thread([args]() {
-        return static_cast<TachyonFunc*>(args.at(1).o)->f({});
-    }));
-    })},
-    {"join", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-    assert(args.at(0).tag == TachyonVal::OBJECT);
-    std::thread* thr = static_cast<TachyonThread*>(args.at(0).o)->t;
-    thr->join();
-    return TachyonVal::make_nil();
-    })}
-    });
-
-TachyonVal FileSystem = TachyonVal::make_object({
-    {"read", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-    assert(args.at(1).tag == TachyonVal::OBJECT);
-    std::string path = static_cast<TachyonString*>(args.at(1).o)->s;
-    std::ifstream in_file;
-    in_file.open(path);
-    std::stringstream strStream;
-    strStream << in_file.rdbuf();
-    std::string text = strStream.str();
-    return TachyonVal::make_str(text);
-    })},
-    {"write", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-    assert(args.at(1).tag == TachyonVal::OBJECT && args.at(2).tag == TachyonVal::OBJECT);
-    std::string path = static_cast<TachyonString*>(args.at(1).o)->s;
-    std::string str = static_cast<TachyonString*>(args.at(2).o)->s;
-    std::ofstream out_file;
-    out_file.open(path);
-    out_file << str;
-    return TachyonVal::make_nil();
-    })}
-    });
-
-TachyonVal Exception = TachyonVal::make_object({
-    {"throw", TachyonVal::make_func([](const std::vector<TachyonVal>& args) {
-    std::string msg = static_cast<TachyonString*>(args.at(0).o->get("msg").o)->s;
-    throw std::runtime_error(msg);
-    return TachyonVal::make_nil();
-    })}
-    });
-
-)VOG0N";
     Transpiler::Transpiler(const std::string& filename)
-        : filename(filename), included_headers({
-            "<cassert>",
-            "<cmath>",
-            "<functional>",
-            "<string>",
-            "<vector>",
-            "<map>",
-            "<iostream>",
-            "<sstream>",
-            "<random>",
-            "<chrono>",
-            "<ctime>",
-            "<thread>",
-            "<algorithm>",
-            "<fstream>",
-            "<cstdint>"
-            }) {
+        : filename(filename) {
     }
 
     void Transpiler::visit(Node* node) {
@@ -661,6 +66,8 @@ TachyonVal Exception = TachyonVal::make_object({
             return visit(static_cast<FuncDeclStmtNode*>(node));
         case NodeKind::RETURN_STMT:
             return visit(static_cast<ReturnStmtNode*>(node));
+        case NodeKind::IMPORT_STMT:
+            return visit(static_cast<ImportStmtNode*>(node));
         case NodeKind::CIMPORT_STMT:
             return visit(static_cast<CImportStmtNode*>(node));
         case NodeKind::TRY_CATCH_STMT:
@@ -670,22 +77,136 @@ TachyonVal Exception = TachyonVal::make_object({
         }
     }
 
-    void Transpiler::visit(NilNode* node) {
+    // Emits a value for dynamic code, boxing it if the inferrer gave it a raw C++ type
+    void Transpiler::visit_boxed(Node* node) {
+        if (node->type == ValueType::NUMBER) {
+            post_main_code << "TachyonVal::make_num(";
+            visit(node);
+            post_main_code << ')';
+        }
+        else if (node->type == ValueType::BOOL) {
+            post_main_code << "TachyonVal::make_bool(";
+            visit(node);
+            post_main_code << ')';
+        }
+        else {
+            visit(node);
+        }
+    }
+
+    void Transpiler::visit_num(Node* node) {
+        if (node->type == ValueType::NUMBER) {
+            visit(node);
+        }
+        else {
+            post_main_code << "tachyon_num(";
+            visit_boxed(node);
+            post_main_code << ')';
+        }
+    }
+
+    void Transpiler::visit_bool(Node* node) {
+        if (node->type == ValueType::BOOL) {
+            visit(node);
+        }
+        else {
+            post_main_code << "tachyon_bool(";
+            visit_boxed(node);
+            post_main_code << ')';
+        }
+    }
+
+    // Emits the condition of an if, while or for as a C++ bool
+    void Transpiler::visit_test(Node* node) {
+        if (node->type == ValueType::BOOL) {
+            visit(node);
+        }
+        else {
+            post_main_code << '(';
+            visit_boxed(node);
+            post_main_code << ").b()";
+        }
+    }
+
+    void Transpiler::visit_as(Node* node, ValueType type) {
+        if (type == ValueType::NUMBER) {
+            visit_num(node);
+        }
+        else if (type == ValueType::BOOL) {
+            visit_bool(node);
+        }
+        else {
+            visit_boxed(node);
+        }
+    }
+
+    static std::string boxed(const std::string& code, ValueType type) {
+        if (type == ValueType::NUMBER) {
+            return "TachyonVal::make_num(" + code + ")";
+        }
+        else if (type == ValueType::BOOL) {
+            return "TachyonVal::make_bool(" + code + ")";
+        }
+        return code;
+    }
+
+    static std::string unboxed(const std::string& code, ValueType type) {
+        if (type == ValueType::NUMBER) {
+            return "tachyon_num(" + code + ")";
+        }
+        else if (type == ValueType::BOOL) {
+            return "tachyon_bool(" + code + ")";
+        }
+        return code;
+    }
+
+    static std::string type_name(ValueType type) {
+        if (type == ValueType::NUMBER) {
+            return "double";
+        }
+        else if (type == ValueType::BOOL) {
+            return "bool";
+        }
+        return "TachyonVal";
+    }
+
+    // Prints a number so that it reads back as the same double
+    static std::string number_literal(double val) {
+        std::ostringstream oss;
+        oss << std::setprecision(15) << val;
+        // strtod, since std::stod throws for subnormal numbers
+        if (std::strtod(oss.str().c_str(), nullptr) != val) {
+            oss.str("");
+            oss << std::setprecision(17) << val;
+        }
+        std::string str = oss.str();
+        if (str.find_first_of(".e") == std::string::npos) {
+            str += ".0";
+        }
+        return str;
+    }
+
+    void Transpiler::visit(NilNode*) {
         post_main_code << "TachyonVal::make_nil()";
     }
 
     void Transpiler::visit(NumberNode* node) {
-        post_main_code << "TachyonVal::make_num(";
-        post_main_code << node->val;
-        post_main_code << ')';
+        if (node->type == ValueType::NUMBER) {
+            post_main_code << number_literal(node->val);
+        }
+        else {
+            post_main_code << "TachyonVal::make_num(";
+            post_main_code << number_literal(node->val);
+            post_main_code << ')';
+        }
     }
 
     void Transpiler::visit(TrueNode* node) {
-        post_main_code << "TachyonVal::make_bool(true)";
+        post_main_code << (node->type == ValueType::BOOL ? "true" : "TachyonVal::make_bool(true)");
     }
 
     void Transpiler::visit(FalseNode* node) {
-        post_main_code << "TachyonVal::make_bool(false)";
+        post_main_code << (node->type == ValueType::BOOL ? "false" : "TachyonVal::make_bool(false)");
     }
 
     void Transpiler::visit(CharNode* node) {
@@ -701,35 +222,113 @@ TachyonVal Exception = TachyonVal::make_object({
     }
 
     void Transpiler::visit(IdentifierNode* node) {
-        post_main_code << node->val;
+        if (node->func) {
+            // A def used as a value refers to its boxed wrapper
+            post_main_code << function_name(node->func) << "_func";
+        }
+        else if (node->env != -1) {
+            post_main_code << "tachyon_env_" << node->env << "->vals[" << node->slot << ']';
+        }
+        else {
+            post_main_code << node->val;
+        }
     }
 
     void Transpiler::visit(ParenExprNode* node) {
         post_main_code << '(';
-        visit(node->node.get());
+        visit(node->node);
         post_main_code << ')';
     }
     void Transpiler::visit(LambdaExprNode* node) {
-        post_main_code << "TachyonVal::make_func([&](const std::vector<TachyonVal>& args) {\n";
-        for (int i = 0; i < node->args.size(); i++) {
-            post_main_code << "TachyonVal " << node->args.at(i) << " = args.at(" << i << ");\n";
+        visit_closure(node->args, node->body, node->env, node->captures, "");
+    }
+
+    // Emits a lambda or def as a TachyonFunc whose std::function captures nothing. Captured
+    // variables are read from the TachyonFunc, either directly or through the TachyonEnv they live in.
+    void Transpiler::visit_closure(const std::vector<std::string>& args, Node* body, const Env& env, const std::vector<Capture>& captures, const std::string& self) {
+        std::vector<const Capture*> copied;
+        std::vector<int> shared;
+        for (const Capture& capture : captures) {
+            if (capture.env == -1) {
+                copied.push_back(&capture);
+            }
+            else if (std::find(shared.begin(), shared.end(), capture.env) == shared.end()) {
+                shared.push_back(capture.env);
+            }
+        }
+        // The parameter is left unnamed when nothing reads it, so the code builds without unused-parameter warnings
+        bool reads_args = !self.empty() || !captures.empty() || !args.empty();
+        post_main_code << "TachyonVal::make_func([](TachyonArgs" << (reads_args ? " args" : "") << ") {\n";
+        if (!self.empty()) {
+            post_main_code << "TachyonVal " << self << " = TachyonVal::make_ptr(args.func);\n";
+        }
+        for (std::size_t i = 0; i < copied.size(); i++) {
+            post_main_code << type_name(copied.at(i)->type) << ' ' << copied.at(i)->name << " = "
+                << unboxed("args.func->captures[" + std::to_string(i) + "]", copied.at(i)->type) << ";\n";
         }
-        if (node->body->kind() == NodeKind::BLOCK_STMT) {
-            visit(node->body.get());
-            post_main_code << "\nreturn TachyonVal::make_nil();\n})";
+        for (std::size_t i = 0; i < shared.size(); i++) {
+            post_main_code << "TachyonEnv* tachyon_env_" << shared.at(i) << " = static_cast<TachyonEnv*>(args.func->captures["
+                << copied.size() + i << "].o());\n";
+        }
+        enter(env);
+        for (std::size_t i = 0; i < args.size(); i++) {
+            int slot = env_slot(args.at(i));
+            if (slot == -1) {
+                post_main_code << "TachyonVal " << args.at(i) << " = args.at(" << i << ");\n";
+            }
+            else {
+                post_main_code << "tachyon_env_" << env.id << "->put(" << slot << ", args.at(" << i << "));\n";
+            }
+        }
+        return_types.push_back(ValueType::DYNAMIC);
+        if (body->kind() == NodeKind::BLOCK_STMT) {
+            visit(body);
+            post_main_code << "\nreturn TachyonVal::make_nil();\n}";
         }
         else {
             post_main_code << "return ";
-            visit(node->body.get());
-            post_main_code << ";\n})";
+            visit_boxed(body);
+            post_main_code << ";\n}";
+        }
+        return_types.pop_back();
+        leave();
+        if (!captures.empty()) {
+            post_main_code << ", {";
+            for (std::size_t i = 0; i < copied.size(); i++) {
+                post_main_code << (i ? ", " : "") << boxed(copied.at(i)->name, copied.at(i)->type);
+            }
+            for (std::size_t i = 0; i < shared.size(); i++) {
+                post_main_code << (i || !copied.empty() ? ", " : "") << "TachyonVal::make_ptr(tachyon_env_" << shared.at(i) << ')';
+            }
+            post_main_code << '}';
+        }
+        post_main_code << ')';
+    }
+
+    // Creates the scope's TachyonEnv, if it has one
+    void Transpiler::enter(const Env& env) {
+        if (env.id != -1) {
+            post_main_code << "TachyonEnv* tachyon_env_" << env.id << " = tachyon_heap.make<TachyonEnv>(" << env.vars.size() << ");\n";
         }
+        envs.push_back(&env);
+    }
+
+    void Transpiler::leave() {
+        envs.pop_back();
+    }
+
+    // Slot of a variable declared in the current scope, or -1 if it is not in its Env
+    int Transpiler::env_slot(const std::string& name) const {
+        const std::vector<std::string>& vars = envs.back()->vars;
+        std::vector<std::string>::const_iterator it = std::find(vars.begin(), vars.end(), name);
+        return it == vars.end() ? -1 : it - vars.begin();
     }
 
     void Transpiler::visit(ObjectNode* node) {
         post_main_code << "TachyonVal::make_object({";
-        for (int i = 0; i < node->keys.size(); i++) {
+        for (std::size_t i = 0; i < node->keys.size(); i++) {
             post_main_code << "{\"" << node->keys.at(i) << "\",";
-            visit(node->vals.at(i).get());
+            visit_boxed(node->vals.at(i));
             post_main_code << '}';
             if (i < node->keys.size() - 1) {
                 post_main_code << ',';
@@ -740,8 +339,8 @@ TachyonVal Exception = TachyonVal::make_object({
 
     void Transpiler::visit(VecNode* node) {
         post_main_code << "TachyonVal::make_vec({";
-        for (int i = 0; i < node->elems.size(); i++) {
-            visit(node->elems.at(i).get());
+        for (std::size_t i = 0; i < node->elems.size(); i++) {
+            visit_boxed(node->elems.at(i));
             if (i < node->elems.size() - 1) {
                 post_main_code << ',';
             }
@@ -750,18 +349,42 @@ TachyonVal Exception = TachyonVal::make_object({
     }
 
     void Transpiler::visit(CallExprNode* node) {
-        visit(node->callee.get());
-        post_main_code << "({";
+        if (node->callee->kind() == NodeKind::IDENTIFIER) {
+            FuncDeclStmtNode* func = static_cast<IdentifierNode*>(node->callee)->func;
+            if (func && func->args.size() == node->args.size()) {
+                post_main_code << function_name(func) << '(';
+                for (std::size_t i = 0; i < node->args.size(); i++) {
+                    visit_as(node->args.at(i), func->arg_types.at(i));
+                    if (i < node->args.size() - 1) {
+                        post_main_code << ", ";
+                    }
+                }
+                post_main_code << ')';
+                return;
+            }
+        }
         if (node->callee->kind() == NodeKind::ATTR_EXPR) {
-            std::shared_ptr<AttrExprNode> attr_expr_node = std::dynamic_pointer_cast<AttrExprNode>(node->callee);
-            visit(attr_expr_node->object.get());
+            // The receiver is evaluated once, into args[0], and the method is looked up on it there
+            AttrExprNode* attr_expr_node = static_cast<AttrExprNode*>(node->callee);
+            std::map<AttrExprNode*, std::size_t>::const_iterator it = hoisted.find(attr_expr_node);
+            if (it != hoisted.end()) {
+                post_main_code << "tachyon_hoist_" << it->second << ".call(tachyon_caches[" << cache_count++ << "], ";
+            }
+            else {
+                post_main_code << "tachyon_caches[" << cache_count++ << "].call(";
+            }
+            post_main_code << '"' << attr_expr_node->attr << "\", {";
+            visit_boxed(attr_expr_node->object);
             if (node->args.size()) {
                 post_main_code << ',';
             }
         }
-
-        for (int i = 0; i < node->args.size(); i++) {
-            visit(node->args.at(i).get());
+        else {
+            visit_boxed(node->callee);
+            post_main_code << "({";
+        }
+        for (std::size_t i = 0; i < node->args.size(); i++) {
+            visit_boxed(node->args.at(i));
             if (i < node->args.size() - 1) {
                 post_main_code << ',';
             }
@@ -771,143 +394,452 @@ TachyonVal Exception = TachyonVal::make_object({
 
     void Transpiler::visit(UnaryExprNode* node) {
         post_main_code << '(';
-        post_main_code << node->op.val;
-        visit(node->node.get());
+        post_main_code << node->op.val.str();
+        if (node->type == ValueType::NUMBER) {
+            visit_num(node->node);
+        }
+        else {
+            visit(node->node);
+        }
         post_main_code << ')';
     }
 
     void Transpiler::visit(BinaryExprNode* node) {
         if (node->node_a->kind() == NodeKind::ATTR_EXPR && node->op.val == "=") {
-            std::shared_ptr<AttrExprNode> attr_expr_node = std::dynamic_pointer_cast<AttrExprNode>(node->node_a);
-            visit(attr_expr_node->object.get());
-            post_main_code << ".o->set(\"" << attr_expr_node->attr << "\",";
-            visit(node->node_b.get());
+            AttrExprNode* attr_expr_node = static_cast<AttrExprNode*>(node->node_a);
+            visit(attr_expr_node->object);
+            post_main_code << ".o()->set(\"" << attr_expr_node->attr << "\",";
+            visit_boxed(node->node_b);
             post_main_code << ')';
         }
-        else {
+        else if (node->node_a->kind() == NodeKind::IDENTIFIER && node->op.val == "="
+            && static_cast<IdentifierNode*>(node->node_a)->env != -1) {
+            IdentifierNode* identifier_node = static_cast<IdentifierNode*>(node->node_a);
+            post_main_code << "tachyon_env_" << identifier_node->env << "->put(" << identifier_node->slot << ", ";
+            visit_boxed(node->node_b);
+            post_main_code << ')';
+        }
+        else if (node->type == ValueType::DYNAMIC) {
             post_main_code << '(';
-            visit(node->node_a.get());
+            visit_boxed(node->node_a);
             post_main_code << ' ';
             if (node->op.val == "^^") {
                 post_main_code << "!=";
             }
             else {
-                post_main_code << node->op.val;
+                post_main_code << node->op.val.str();
             }
             post_main_code << ' ';
-            visit(node->node_b.get());
+            visit_boxed(node->node_b);
+            post_main_code << ')';
+        }
+        else {
+            visit_unboxed(node);
+        }
+    }
+
+    // Emits an operator whose result the inferrer typed as a raw double or bool
+    void Transpiler::visit_unboxed(BinaryExprNode* node) {
+        std::string op = node->op.val;
+        if (op == "=" || op == "==" || op == "!=" || op == "^^") {
+            // Both sides have the same raw type here
+            post_main_code << '(';
+            visit(node->node_a);
+            post_main_code << ' ' << (op == "^^" ? "!=" : op) << ' ';
+            visit(node->node_b);
+            post_main_code << ')';
+        }
+        else if (op == "&&" || op == "||") {
+            post_main_code << '(';
+            visit_bool(node->node_a);
+            post_main_code << ' ' << op << ' ';
+            visit_bool(node->node_b);
+            post_main_code << ')';
+        }
+        else if (op == "%") {
+            post_main_code << "std::fmod(";
+            visit_num(node->node_a);
+            post_main_code << ", ";
+            visit_num(node->node_b);
+            post_main_code << ')';
+        }
+        else if (op == "<<" || op == ">>" || op == "&" || op == "|" || op == "^") {
+            post_main_code << "(double)((int64_t)";
+            visit_num(node->node_a);
+            post_main_code << ' ' << op << " (int64_t)";
+            visit_num(node->node_b);
+            post_main_code << ')';
+        }
+        else {
+            post_main_code << '(';
+            visit_num(node->node_a);
+            post_main_code << ' ' << op << ' ';
+            visit_num(node->node_b);
             post_main_code << ')';
         }
     }
 
     void Transpiler::visit(ExprStmtNode* node) {
-        visit(node->node.get());
+        visit(node->node);
         post_main_code << ";";
     }
 
     void Transpiler::visit(AttrExprNode* node) {
-        visit(node->object.get());
-        post_main_code << ".o->get(\"" << node->attr << "\")";
+        std::map<AttrExprNode*, std::size_t>::const_iterator it = hoisted.find(node);
+        if (it != hoisted.end()) {
+            post_main_code << "tachyon_hoist_" << it->second << ".get(tachyon_caches[" << cache_count++ << "], ";
+        }
+        else {
+            post_main_code << "tachyon_caches[" << cache_count++ << "].get(";
+        }
+        visit_boxed(node->object);
+        post_main_code << ".o(), \"" << node->attr << "\")";
     }
 
     void Transpiler::visit(VarDeclStmtNode* node) {
-        post_main_code << "TachyonVal ";
-        post_main_code << node->name;
-        post_main_code << " = ";
-        visit(node->val.get());
+        int slot = env_slot(node->name);
+        if (slot != -1) {
+            post_main_code << "tachyon_env_" << envs.back()->id << "->put(" << slot << ", ";
+            visit_boxed(node->val);
+            post_main_code << ");";
+            return;
+        }
+        post_main_code << type_name(node->type) << ' ' << node->name << " = ";
+        visit_as(node->val, node->type);
         post_main_code << ';';
     }
 
     void Transpiler::visit(BlockStmtNode* node) {
         post_main_code << "{\n";
-        visit(node->node.get());
+        enter(node->env);
+        visit(node->node);
+        leave();
         post_main_code << "}";
     }
 
     void Transpiler::visit(IfStmtNode* node) {
-        post_main_code << "if((";
-        visit(node->test.get());
-        post_main_code << ").b) ";
-        visit(node->body.get());
+        post_main_code << "if(";
+        visit_test(node->test);
+        post_main_code << ") ";
+        visit(node->body);
     }
 
     void Transpiler::visit(IfElseStmtNode* node) {
-        post_main_code << "if((";
-        visit(node->test.get());
-        post_main_code << ").b) ";
-        visit(node->body.get());
+        post_main_code << "if(";
+        visit_test(node->test);
+        post_main_code << ") ";
+        visit(node->body);
         post_main_code << " else ";
-        visit(node->alternate.get());
+        visit(node->alternate);
+    }
+
+    // Variables a loop assigns to or sets members of. Loads on them would be invalidated on every
+    // iteration, so they aren't hoisted.
+    static void collect_writes(Node* node, std::set<std::string>& names) {
+        if (node->kind() == NodeKind::BINARY_EXPR && static_cast<BinaryExprNode*>(node)->op.val == "=") {
+            Node* target = static_cast<BinaryExprNode*>(node)->node_a;
+            if (target->kind() == NodeKind::ATTR_EXPR) {
+                target = static_cast<AttrExprNode*>(target)->object;
+            }
+            if (target->kind() == NodeKind::IDENTIFIER) {
+                names.insert(static_cast<IdentifierNode*>(target)->val);
+            }
+        }
+        else if (node->kind() == NodeKind::VAR_DECL_STMT) {
+            names.insert(static_cast<VarDeclStmtNode*>(node)->name);
+        }
+        for (Node* child : children(node)) {
+            collect_writes(child, names);
+        }
+    }
+
+    // Member loads on variables, outside the lambdas and defs in node, since those are separate C++ functions
+    static void collect_loads(Node* node, const std::set<std::string>& writes, std::vector<AttrExprNode*>& loads) {
+        if (node->kind() == NodeKind::LAMBDA_EXPR || node->kind() == NodeKind::FUNC_DECL_STMT) {
+            return;
+        }
+        if (node->kind() == NodeKind::BINARY_EXPR && static_cast<BinaryExprNode*>(node)->op.val == "="
+            && static_cast<BinaryExprNode*>(node)->node_a->kind() == NodeKind::ATTR_EXPR) {
+            // A member set, not a load
+            collect_loads(static_cast<AttrExprNode*>(static_cast<BinaryExprNode*>(node)->node_a)->object, writes, loads);
+            collect_loads(static_cast<BinaryExprNode*>(node)->node_b, writes, loads);
+            return;
+        }
+        if (node->kind() == NodeKind::ATTR_EXPR) {
+            AttrExprNode* attr_expr_node = static_cast<AttrExprNode*>(node);
+            if (attr_expr_node->object->kind() == NodeKind::IDENTIFIER
+                && !writes.count(static_cast<IdentifierNode*>(attr_expr_node->object)->val)) {
+                loads.push_back(attr_expr_node);
+            }
+        }
+        for (Node* child : children(node)) {
+            collect_loads(child, writes, loads);
+        }
+    }
+
+    // Gives member loads in a loop on variables it doesn't change a TachyonHoist declared just
+    // before it, so they are looked up again only when the receiver or one of the objects the
+    // member was found through changes. Loads in nested loops are hoisted with the outermost one.
+    void Transpiler::hoist_loads(const std::vector<Node*>& parts) {
+        std::set<std::string> writes;
+        for (Node* part : parts) {
+            collect_writes(part, writes);
+        }
+        std::vector<AttrExprNode*> loads;
+        for (Node* part : parts) {
+            collect_loads(part, writes, loads);
+        }
+        for (AttrExprNode* load : loads) {
+            if (!hoisted.count(load)) {
+                hoisted[load] = hoist_count;
+                post_main_code << "TachyonHoist tachyon_hoist_" << hoist_count++ << ";\n";
+            }
+        }
     }
 
     void Transpiler::visit(WhileStmtNode* node) {
-        post_main_code << "while((";
-        visit(node->test.get());
-        post_main_code << ").b)";
-        visit(node->body.get());
+        hoist_loads({node->test, node->body});
+        post_main_code << "while(";
+        visit_test(node->test);
+        post_main_code << ") {\ntachyon_heap.safepoint();\n";
+        visit(node->body);
+        post_main_code << "\n}";
     }
 
     void Transpiler::visit(ForStmtNode* node) {
+        hoist_loads({node->test, node->update, node->body});
+        if (node->env.id != -1) {
+            post_main_code << "{\n";
+        }
+        enter(node->env);
         post_main_code << "for(";
-        visit(node->init.get());
+        visit(node->init);
         post_main_code << ' ';
-        post_main_code << "(";
-        visit(node->test.get());
-        post_main_code << ").b; ";
-        visit(node->update.get());
-        post_main_code << ") ";
-        visit(node->body.get());
+        visit_test(node->test);
+        post_main_code << "; ";
+        visit(node->update);
+        post_main_code << ") {\ntachyon_heap.safepoint();\n";
+        visit(node->body);
+        post_main_code << "\n}";
+        leave();
+        if (node->env.id != -1) {
+            post_main_code << "\n}";
+        }
     }
 
     void Transpiler::visit(FuncDeclStmtNode* node) {
-        post_main_code << "TachyonVal " << node->name << " = TachyonVal::make_func([&](const std::vector<TachyonVal>& args) {\n";
-        for (int i = 0; i < node->args.size(); i++) {
-            post_main_code << "TachyonVal " << node->args.at(i) << " = args.at(" << i << ");\n";
+        int slot = env_slot(node->name);
+        if (node->direct) {
+            visit_direct(node);
+            if (slot != -1) {
+                // Exported from a module, so it is stored like any other top-level variable
+                post_main_code << "tachyon_env_" << envs.back()->id << "->put(" << slot << ", " << function_name(node) << "_func);";
+            }
+            return;
+        }
+        if (slot == -1) {
+            post_main_code << "TachyonVal " << node->name << " = ";
+            visit_closure(node->args, node->body, node->env, node->captures, node->recursive ? node->name : "");
+            post_main_code << ';';
+        }
+        else {
+            post_main_code << "tachyon_env_" << envs.back()->id << "->put(" << slot << ", ";
+            visit_closure(node->args, node->body, node->env, node->captures, "");
+            post_main_code << ");";
+        }
+    }
+
+    std::string Transpiler::function_name(FuncDeclStmtNode* node) {
+        std::map<FuncDeclStmtNode*, std::string>::iterator it = function_names.find(node);
+        if (it != function_names.end()) {
+            return it->second;
+        }
+        std::string name = "tachyon_def_" + node->name + "_" + std::to_string(function_names.size());
+        function_names[node] = name;
+        return name;
+    }
+
+    // Emits a def as a top-level C++ function with typed parameters, plus a boxed wrapper
+    // if the def is ever used as a value
+    void Transpiler::visit_direct(FuncDeclStmtNode* node) {
+        std::string name = function_name(node);
+        std::string signature = type_name(node->type) + " " + name + "(";
+        std::string call = name + "(";
+        for (std::size_t i = 0; i < node->args.size(); i++) {
+            signature += type_name(node->arg_types.at(i)) + " " + node->args.at(i);
+            call += "args.at(" + std::to_string(i) + ")";
+            if (i < node->args.size() - 1) {
+                signature += ", ";
+                call += ", ";
+            }
+        }
+        signature += ")";
+        call += ")";
+        prototype_code += "static " + signature + ";\n";
+        if (node->escapes) {
+            call = boxed(call, node->type);
+            wrapper_code += "static TachyonVal " + name + "_func;\n";
+            init_code += name + "_func = TachyonVal::make_func([](TachyonArgs" + (node->args.empty() ? "" : " args") + ") {\nreturn " + call + ";\n});\n";
         }
-        visit(node->body.get());
-        post_main_code << "\nreturn TachyonVal::make_nil();\n});";
+        std::string code = post_main_code.str();
+        post_main_code.str("");
+        return_types.push_back(node->type);
+        post_main_code << signature << " {\ntachyon_heap.safepoint();\n";
+        enter(node->env);
+        for (std::size_t i = 0; i < node->args.size(); i++) {
+            int slot = env_slot(node->args.at(i));
+            if (slot != -1) {
+                post_main_code << "tachyon_env_" << node->env.id << "->put(" << slot << ", " << node->args.at(i) << ");\n";
+            }
+        }
+        visit(node->body);
+        leave();
+        if (node->type == ValueType::DYNAMIC) {
+            post_main_code << "\nreturn TachyonVal::make_nil();";
+        }
+        post_main_code << "\n}\n";
+        return_types.pop_back();
+        function_code += post_main_code.str();
+        post_main_code.str("");
+        post_main_code << code;
     }
 
     void Transpiler::visit(ReturnStmtNode* node) {
         post_main_code << "return ";
-        visit(node->node.get());
+        visit_as(node->node, return_types.empty() ? ValueType::DYNAMIC : return_types.back());
         post_main_code << ';';
     }
 
 
     void Transpiler::visit(TryCatchStmtNode* node) {
         post_main_code << "try ";
-        visit(node->try_body.get());
-        post_main_code << "catch(const std::exception& _e) {\nTachyonVal " << node->ex
-            << " = TachyonVal::make_object({{\"msg\",TachyonVal::make_str(_e.what())},{\"proto\",Exception}});\n";
-        visit(node->catch_body.get());
+        visit(node->try_body);
+        post_main_code << "catch(const std::exception& _e) {\n";
+        enter(node->env);
+        std::string ex = "TachyonVal::make_object({{\"msg\",TachyonVal::make_str(_e.what())},{\"proto\",Exception}})";
+        int slot = env_slot(node->ex);
+        if (slot == -1) {
+            post_main_code << "TachyonVal " << node->ex << " = " << ex << ";\n";
+        }
+        else {
+            post_main_code << "tachyon_env_" << node->env.id << "->put(" << slot << ", " << ex << ");\n";
+        }
+        visit(node->catch_body);
+        leave();
         post_main_code << "\n}";
     }
     
 
+    // Runs the module's top-level code if it hasn't run yet, and names its TachyonEnv
+    void Transpiler::visit(ImportStmtNode* node) {
+        const std::string& id = node->module->id;
+        if (imported_ids.insert(id).second) {
+            import_code += "extern TachyonEnv* tachyon_module_" + id + ";\nvoid tachyon_module_" + id + "_init();\n";
+        }
+        post_main_code << "tachyon_module_" << id << "_init();";
+        if (!node->env.vars.empty()) {
+            post_main_code << "\nTachyonEnv* tachyon_env_" << node->env.id << " = tachyon_module_" << id << ';';
+        }
+    }
+
     void Transpiler::visit(CImportStmtNode* node) {
         included_headers.insert("\"" + node->path + "\"");
     }
 
     void Transpiler::visit(StmtListNode* node) {
-        for (int i = 0; i < node->stmts.size(); i++) {
-            std::shared_ptr<Node> stmt = node->stmts.at(i);
-            visit(stmt.get());
+        for (std::size_t i = 0; i < node->stmts.size(); i++) {
+            Node* stmt = node->stmts.at(i);
+            visit(stmt);
             post_main_code << '\n';
         }
     }
 
-    std::string Transpiler::generate_code(Node* node) {
-        visit(node);
-        std::string code = "// Generated by Tachyon\n";
+    // Paths of the headers included with cimport, as written in the program
+    std::vector<std::string> Transpiler::local_headers() const {
+        std::vector<std::string> headers;
         for (const std::string& header : included_headers) {
-            code += "#include " + header + "\n";
+            if (header.front() == '"') {
+                headers.push_back(header.substr(1, header.size() - 2));
+            }
+        }
+        return headers;
+    }
 
+    // Everything before main or the module's functions
+    void Transpiler::write_declarations(std::ostream& out) const {
+        out << "// Generated by Tachyon\n#include \"tachyon.h\"\n";
+        for (const std::string& header : included_headers) {
+            out << "#include " << header << "\n";
         }
-        code += boilerplate;
-        code += "int main(int argc, char** argv) {\n";
-        code += post_main_code.str();
-        code += "    return 0;\n}";
-        return code;
+        out << import_code;
+        if (cache_count) {
+            out << "static thread_local TachyonCache tachyon_caches[" << cache_count << "];\n";
+        }
+        out << prototype_code;
+        out << wrapper_code;
+        out << function_code;
+    }
+
+    // Visits the whole program, which write_code then writes out
+    void Transpiler::translate(Node* node) {
+        Env env;
+        enter(node->kind() == NodeKind::STMT_LIST ? static_cast<StmtListNode*>(node)->env : env);
+        visit(node);
+        leave();
+    }
+
+    // Writes the program piece by piece, so it can go straight into a pipe to the compiler. It can
+    // be written more than once. modules are all the modules the program imports, directly or not.
+    void Transpiler::write_code(std::ostream& out, const std::vector<Module*>& modules) {
+        write_declarations(out);
+        for (Module* module : modules) {
+            out << "void tachyon_module_" << module->id << "_create();\n";
+        }
+        out << "int main(int argc, char** argv) {\n";
+        // Globals in the runtime library are only guaranteed to be constructed once main runs.
+        // Objects made before the heap is attached are never collected.
+        for (Module* module : modules) {
+            out << "tachyon_module_" << module->id << "_create();\n";
+        }
+        out << init_code;
+        out << "TachyonMutator tachyon_mutator;\ntachyon_heap.attach(&tachyon_mutator);\n";
+        // Writing an empty buffer would set failbit on out
+        if (post_main_code.tellp() > 0) {
+            post_main_code.rdbuf()->pubseekpos(0, std::ios_base::in);
+            out << post_main_code.rdbuf();
+        }
+        out << "    tachyon_heap.detach(&tachyon_mutator);\n";
+        out << "    return 0;\n}";
+    }
+
+    std::string Transpiler::generate_code(Node* node, const std::vector<Module*>& modules) {
+        translate(node);
+        std::ostringstream out;
+        write_code(out, modules);
+        return out.str();
+    }
+
+    // A module has no main. Its TachyonEnv and def wrappers are made by tachyon_module_<id>_create,
+    // which the program's main calls before attaching to the heap, and its top-level code runs in
+    // tachyon_module_<id>_init, which each import of it calls.
+    std::string Transpiler::generate_module(Node* node, const Module& module) {
+        StmtListNode* stmt_list_node = static_cast<StmtListNode*>(node);
+        envs.push_back(&stmt_list_node->env);
+        visit(node);
+        leave();
+        std::string env = "tachyon_module_" + module.id;
+        std::ostringstream out;
+        write_declarations(out);
+        out << "TachyonEnv* " << env << " = nullptr;\n";
+        out << "void " << env << "_create() {\n";
+        out << env << " = tachyon_heap.make<TachyonEnv>(" << module.exports.size() << ");\n";
+        out << init_code;
+        out << "}\n";
+        out << "void " << env << "_init() {\n";
+        out << "static bool done = false;\nif (done) {\nreturn;\n}\ndone = true;\n";
+        out << "TachyonEnv* tachyon_env_" << stmt_list_node->env.id << " = " << env << ";\n";
+        out << post_main_code.str();
+        out << "}\n";
+        return out.str();
     }
 }; // namespace tachyon
\ No newline at end of file
@@ -4,17 +4,45 @@
 #include <string>
 #include <sstream>
 #include <set>
+#include <map>
+#include <vector>
 #include "node.h"
 
 namespace tachyon {
+    class Module;
+
     class Transpiler {
     private:
-        static const std::string boilerplate;
         std::string filename{};
-        std::string imported_code{};
-        std::ostringstream post_main_code{};
+        // Read back in place by write_code, so it is never copied into a string
+        std::stringstream post_main_code{};
         std::set<std::string> included_headers{};
+        std::size_t cache_count{};
+        // Member loads moved out of loops, and the TachyonHoist each uses
+        std::map<AttrExprNode*, std::size_t> hoisted{};
+        std::size_t hoist_count{};
+        std::string prototype_code{};
+        std::string wrapper_code{};
+        std::string init_code{};
+        std::string import_code{};
+        std::set<std::string> imported_ids{};
+        std::string function_code{};
+        std::map<FuncDeclStmtNode*, std::string> function_names{};
+        std::vector<ValueType> return_types{};
+        std::vector<const Env*> envs{};
+        std::string function_name(FuncDeclStmtNode* node);
+        void enter(const Env& env);
+        void leave();
+        int env_slot(const std::string& name) const;
+        void visit_direct(FuncDeclStmtNode* node);
+        void visit_closure(const std::vector<std::string>& args, Node* body, const Env& env, const std::vector<Capture>& captures, const std::string& self);
         void visit(Node* node);
+        void visit_boxed(Node* node);
+        void visit_num(Node* node);
+        void visit_bool(Node* node);
+        void visit_test(Node* node);
+        void visit_as(Node* node, ValueType type);
+        void hoist_loads(const std::vector<Node*>& parts);
         void visit(NilNode* node);
         void visit(NumberNode* node);
         void visit(TrueNode* node);
@@ -30,6 +58,7 @@ namespace tachyon {
         void visit(AttrExprNode* node);
         void visit(UnaryExprNode* node);
         void visit(BinaryExprNode* node);
+        void visit_unboxed(BinaryExprNode* node);
         void visit(ExprStmtNode* node);
         void visit(VarDeclStmtNode* node);
         void visit(BlockStmtNode* node);
@@ -41,10 +70,16 @@ namespace tachyon {
         void visit(FuncDeclStmtNode* node);
         void visit(ReturnStmtNode* node);
         void visit(TryCatchStmtNode* node);
+        void visit(ImportStmtNode* node);
         void visit(CImportStmtNode* node);
+        void write_declarations(std::ostream& out) const;
     public:
         Transpiler(const std::string& filename);
-        std::string generate_code(Node* node);
+        void translate(Node* node);
+        void write_code(std::ostream& out, const std::vector<Module*>& modules = {});
+        std::string generate_code(Node* node, const std::vector<Module*>& modules = {});
+        std::string generate_module(Node* node, const Module& module);
+        std::vector<std::string> local_headers() const;
     };
 } // namespace tachyon
 
@@ -0,0 +1,42 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../src/token.h"
+#include "../../src/lexer.h"
+
+// Lexes a synthetic source of the given size in megabytes (32 by default) and prints the throughput
+int main(int argc, char** argv) {
+    std::size_t size = (argc > 1 ? std::atoi(argv[1]) : 32) * 1024 * 1024;
+    std::string text;
+    text.reserve(size + 256);
+    for (int i = 0; text.size() < size; i++) {
+        std::string n = std::to_string(i);
+        text += "// Function number " + n + "\n";
+        text += "def function_" + n + "(a, b) {\n";
+        text += "    var total = a * 3.25e2 + b / " + n + ";\n";
+        text += "    if (total >= 100 && a != nil) { System.print(\"large \" + total); }\n";
+        text += "    else { total = total % 7 << 2; }\n";
+        text += "    var xs = [1, 2, 3, 'x'];\n";
+        text += "    while (total > 0) { total = total - 1; }\n";
+        text += "    return lambda(c) { return c + total; };\n";
+        text += "}\n";
+    }
+
+    double best = 0.0;
+    std::size_t count = 0;
+    for (int run = 0; run < 5; run++) {
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        tachyon::Lexer lexer(text, "lexer.tachyon");
+        std::vector<tachyon::Token> tokens = lexer.generate_tokens();
+        std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t2 - t1).count();
+        double mb_per_s = text.size() / seconds / (1024 * 1024);
+        if (mb_per_s > best) {
+            best = mb_per_s;
+        }
+        count = tokens.size();
+    }
+    std::cout << text.size() / (1024 * 1024) << " MB, " << count << " tokens, " << best << " MB/s\n";
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Builds each program in test/programs with the given tachyonc and compares its output with the
+# .expected file next to it. Every program is built both with and without -ndebug, so checks that
+# must survive the release profile are covered, and each build also runs on four threads with a
+# 64 KB nursery, so garbage collector and thread pool bugs show up on small inputs. Imports are
+# relative to test/programs, where the programs are built.
+tachyonc=${1:-tachyonc}
+cd "$(dirname "$0")/programs" || exit 1
+failed=0
+for program in *.tachyon; do
+    name=${program%.tachyon}
+    for flags in "" "-ndebug"; do
+        if ! "$tachyonc" "$program" -nocache $flags; then
+            echo "FAIL $name $flags: does not compile"
+            failed=1
+            continue
+        fi
+        for env in "" "TACHYON_THREADS=4 TACHYON_GC_NURSERY_SIZE=65536"; do
+            if env $env "./$name" | diff -u "$name.expected" - >/dev/null; then
+                echo "ok   $name $flags $env"
+            else
+                echo "FAIL $name $flags $env"
+                env $env "./$name" | diff -u "$name.expected" -
+                failed=1
+            fi
+        done
+        rm -f "$name"
+    done
+done
+exit $failed